@@ -0,0 +1,733 @@
+#include <Zerengine.hpp>
+
+#include <charconv>
+#include <limits>
+#include <string_view>
+
+// Components declaration.
+template <std::size_t I>
+struct [[nodiscard]] Value final: public IComponent {
+public:
+    constexpr Value(float new_value) noexcept:
+        value(new_value) {
+    }
+
+public:
+    float value;
+};
+
+template <std::size_t I>
+struct [[nodiscard]] Marker final: public IComponent {};
+
+struct [[nodiscard]] SparseMarker final: public IComponent {
+    static constexpr auto storage = Storage::Sparse;
+};
+
+// Benchmark harness.
+struct [[nodiscard]] BenchResult final {
+    std::string name;
+    std::size_t entities;
+    std::size_t operations;
+    double best_ns_per_op;
+    double mean_ns_per_op;
+};
+
+struct [[nodiscard]] BenchConfig final {
+    std::size_t max_entities = 1'000'000;
+    std::size_t repetitions = 3;
+    std::string out_path = "zerengine_bench.json";
+    std::string filter;
+};
+
+class [[nodiscard]] BenchReport final {
+public:
+    BenchReport(const BenchConfig& new_config) noexcept:
+        config(new_config) {
+    }
+
+    [[nodiscard]] auto is_enabled(std::string_view name) const noexcept -> bool {
+        return config.filter.empty() || name.find(config.filter) != std::string_view::npos;
+    }
+
+    // Runs setup (untimed), then function (timed), then teardown (untimed) for each repetition.
+    template <typename Setup, typename Function, typename Teardown>
+    void run(std::string_view name, const std::size_t entities, const std::size_t operations, Setup&& setup, Function&& function, Teardown&& teardown) noexcept {
+        if (!is_enabled(name) || entities > config.max_entities) {
+            return;
+        }
+
+        double best = std::numeric_limits<double>::max();
+        double total = 0;
+        for (std::size_t i = 0; i < config.repetitions; i++) {
+            setup();
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            const auto end = std::chrono::steady_clock::now();
+            teardown();
+
+            const double ns_per_op = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(std::max<std::size_t>(operations, 1));
+            best = std::min(best, ns_per_op);
+            total += ns_per_op;
+        }
+
+        results.emplace_back(std::string(name), entities, operations, best, total / static_cast<double>(config.repetitions));
+        std::println("{:<40} entities={:<8} ops={:<8} best={:>12.2f} ns/op mean={:>12.2f} ns/op", name, entities, operations, best, total / static_cast<double>(config.repetitions));
+    }
+
+    void write_json() const noexcept {
+        std::ofstream file(config.out_path);
+        if (!file) {
+            std::println("zerengine_bench: Impossible d'ouvrir le fichier: {}", config.out_path);
+            return;
+        }
+        file << "{\n";
+        file << "  \"zerengine_version\": \"" << ZERENGINE_VERSION_MAJOR << "." << ZERENGINE_VERSION_MINOR << "." << ZERENGINE_VERSION_PATCH << "\",\n";
+        #ifdef __VERSION__
+            file << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+        #endif
+        #ifdef ZERENGINE_BENCH_BUILD_TYPE
+            file << "  \"build_type\": \"" << ZERENGINE_BENCH_BUILD_TYPE << "\",\n";
+        #endif
+        file << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+        file << "  \"repetitions\": " << config.repetitions << ",\n";
+        file << "  \"results\": [";
+        for (std::size_t i = 0; i < results.size(); i++) {
+            const auto& result = results[i];
+            file << (i == 0 ? "" : ",") << "\n    {"
+                << "\"name\": \"" << result.name << "\", "
+                << "\"entities\": " << result.entities << ", "
+                << "\"operations\": " << result.operations << ", "
+                << "\"best_ns_per_op\": " << result.best_ns_per_op << ", "
+                << "\"mean_ns_per_op\": " << result.mean_ns_per_op << "}";
+        }
+        file << "\n  ]\n}\n";
+        std::println("zerengine_bench: {} resultats ecrits dans {}", results.size(), config.out_path);
+    }
+
+private:
+    const BenchConfig& config;
+    std::vector<BenchResult> results;
+};
+
+static BenchConfig bench_config;
+static volatile float bench_sink = 0;
+static std::size_t scene_nb_entities = 0;
+
+constexpr void empty_scene(SceneSystem, World&) noexcept {
+}
+
+void populated_scene(SceneSystem, World& world) noexcept {
+    for (std::size_t i = 0; i < scene_nb_entities; i++) {
+        world.create_entity(Value<0>(static_cast<float>(i)), Value<1>(1.0f));
+    }
+}
+
+// Removes every entity through the regular scene teardown.
+void clear_world(World& world) noexcept {
+    world.load_scene(empty_scene);
+    world.upgrade();
+}
+
+template <std::size_t... Is>
+void create_entities(World& world, const std::size_t nb_entities, std::index_sequence<Is...>) noexcept {
+    for (std::size_t i = 0; i < nb_entities; i++) {
+        world.create_entity(Value<Is>(static_cast<float>(i))...);
+    }
+}
+
+template <std::size_t... Is>
+[[nodiscard]] auto iterate(World& world, std::index_sequence<Is...>) noexcept -> float {
+    float sum = 0;
+    for (const auto& row: world.query<Value<Is>...>()) {
+        std::apply([&sum](const Entity, const auto&... values) {
+            sum += (values.value + ...);
+        }, row);
+    }
+    return sum;
+}
+
+[[nodiscard]] auto iterate_bench_name(const std::size_t nb_components) noexcept -> std::string {
+    return "iterate/" + std::to_string(nb_components) + "_components";
+}
+
+template <std::size_t NbComponents>
+void bench_iteration(BenchReport& report, World& world, const std::size_t nb_entities) noexcept {
+    report.run(
+        iterate_bench_name(NbComponents), nb_entities, nb_entities,
+        [] {},
+        [&] { bench_sink = iterate(world, std::make_index_sequence<NbComponents>()); },
+        [] {}
+    );
+}
+
+void bench_entities(BenchReport& report, World& world, const std::size_t nb_entities) noexcept {
+    report.run(
+        "entity/create", nb_entities, nb_entities,
+        [] {},
+        [&] {
+            create_entities(world, nb_entities, std::make_index_sequence<2>());
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    std::vector<Entity> entities;
+    report.run(
+        "entity/delete", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.delete_entity(entity);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "component/add", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.add_components(entity, Value<1>(1.0f));
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "component/remove", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.remove_components<Value<1>>(entity);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "component/add_marker_toggle", nb_entities, nb_entities * 2,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f), Value<2>(2.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.add_components(entity, Marker<0>());
+            }
+            world.upgrade();
+            for (const auto entity: entities) {
+                world.remove_components<Marker<0>>(entity);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "component/add_sparse_marker_toggle", nb_entities, nb_entities * 2,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f), Value<2>(2.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.add_components(entity, SparseMarker());
+            }
+            world.upgrade();
+            for (const auto entity: entities) {
+                world.remove_components<SparseMarker>(entity);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "upgrade/net_zero_marker", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f), Value<2>(2.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                world.add_components(entity, Marker<0>());
+                world.remove_components<Marker<0>>(entity);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "upgrade/apply_add_components", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f)));
+            }
+            world.upgrade();
+            for (const auto entity: entities) {
+                world.add_components(entity, Value<1>(1.0f));
+            }
+        },
+        [&] { world.upgrade(); },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "entity/get_components", nb_entities, nb_entities,
+        [&] {
+            entities.clear();
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                entities.emplace_back(world.create_entity(Value<0>(0.0f), Value<1>(1.0f), Value<2>(2.0f)));
+            }
+            world.upgrade();
+        },
+        [&] {
+            for (const auto entity: entities) {
+                if (auto opt = world.get_components<Value<0>, Value<2>>(entity)) {
+                    auto [value_0, value_2] = opt.value();
+                    bench_sink = value_0.value + value_2.value;
+                }
+            }
+        },
+        [&] { clear_world(world); }
+    );
+}
+
+template <std::size_t... Is>
+void create_marker_archetypes(World& world, const std::size_t nb_entities, std::index_sequence<Is...>) noexcept {
+    for (std::size_t i = 0; i < nb_entities; i++) {
+        auto entity = world.create_entity(Value<0>(0.0f));
+        ([&] {
+            if (i & (1 << Is)) {
+                world.add_components(entity, Marker<Is>());
+            }
+        }(), ...);
+    }
+    world.upgrade();
+}
+
+void bench_queries(BenchReport& report, World& world, const std::size_t nb_entities) noexcept {
+    constexpr std::size_t NB_QUERIES = 10'000;
+    report.run(
+        "query/construct_64_archetypes", nb_entities, NB_QUERIES,
+        [&] { create_marker_archetypes(world, nb_entities, std::make_index_sequence<6>()); },
+        [&] {
+            for (std::size_t i = 0; i < NB_QUERIES; i++) {
+                bench_sink = static_cast<float>(world.query<Value<0>>(with<Marker<1>>, without<Marker<4>>).size());
+            }
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "query/count_64_archetypes", nb_entities, NB_QUERIES,
+        [&] { create_marker_archetypes(world, nb_entities, std::make_index_sequence<6>()); },
+        [&] {
+            for (std::size_t i = 0; i < NB_QUERIES; i++) {
+                bench_sink = static_cast<float>(world.count<Value<0>>(with<Marker<1>>, without<Marker<4>>));
+            }
+        },
+        [&] { clear_world(world); }
+    );
+
+    // Only entity with all the markers: the walk stops at the second match of a partial query.
+    report.run(
+        "query/single_64_archetypes", nb_entities, NB_QUERIES,
+        [&] { create_marker_archetypes(world, nb_entities, std::make_index_sequence<6>()); },
+        [&] {
+            for (std::size_t i = 0; i < NB_QUERIES; i++) {
+                if (auto opt_row = world.single<Value<0>>(with<Marker<0>, Marker<1>, Marker<2>, Marker<3>, Marker<4>, Marker<5>>)) {
+                    bench_sink = std::get<1>(opt_row.value()).value;
+                }
+            }
+        },
+        [&] { clear_world(world); }
+    );
+
+    // Keys unchanged since the last upgrade: the archetype rows are already in order, only merged.
+    report.run(
+        "query/order_by_64_archetypes", nb_entities, nb_entities,
+        [&] {
+            create_marker_archetypes(world, nb_entities, std::make_index_sequence<6>());
+            std::size_t i = 0;
+            for (auto [entity, value]: world.query<Value<0>>()) {
+                value.value = static_cast<float>((i++ * 7919) % nb_entities);
+            }
+            bench_sink = static_cast<float>(world.query<const Value<0>>(order_by<&Value<0>::value>).size());
+            world.upgrade();
+        },
+        [&] {
+            float sum = 0;
+            for (const auto& [entity, value]: world.query<const Value<0>>(order_by<&Value<0>::value>)) {
+                sum += value.value;
+            }
+            bench_sink = sum;
+        },
+        [&] { clear_world(world); }
+    );
+}
+
+void bench_hierarchy(BenchReport& report, World& world, const std::size_t nb_entities) noexcept {
+    constexpr std::size_t NB_CHILDREN = 10;
+    const std::size_t nb_parents = nb_entities / (NB_CHILDREN + 1);
+    std::vector<Entity> parents;
+    std::vector<std::vector<Entity>> children;
+
+    const auto create_family = [&] {
+        parents.clear();
+        children.clear();
+        for (std::size_t i = 0; i < nb_parents; i++) {
+            parents.emplace_back(world.create_entity(Value<0>(0.0f)));
+            auto& new_children = children.emplace_back();
+            for (std::size_t j = 0; j < NB_CHILDREN; j++) {
+                new_children.emplace_back(world.create_entity(Value<0>(1.0f)));
+            }
+        }
+        world.upgrade();
+    };
+
+    const auto append_family = [&] {
+        for (std::size_t i = 0; i < nb_parents; i++) {
+            world.append_children(parents[i], children[i]);
+        }
+        world.upgrade();
+    };
+
+    report.run(
+        "hierarchy/append_children", nb_entities, nb_parents * NB_CHILDREN,
+        create_family,
+        append_family,
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "hierarchy/set_inactive_cascade", nb_entities, nb_parents * (NB_CHILDREN + 1),
+        [&] {
+            create_family();
+            append_family();
+        },
+        [&] {
+            for (const auto parent: parents) {
+                world.set_inactive(parent);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "hierarchy/iterate_with_parent", nb_entities, nb_parents * NB_CHILDREN,
+        [&] {
+            create_family();
+            append_family();
+        },
+        [&] {
+            float sum = 0;
+            for (const auto& [child, value, parent_value]: world.query<Value<0>>(with_parent<const Value<0>>)) {
+                sum += value.value + parent_value.value;
+            }
+            bench_sink = sum;
+        },
+        [&] { clear_world(world); }
+    );
+
+    report.run(
+        "hierarchy/delete_cascade", nb_entities, nb_parents * (NB_CHILDREN + 1),
+        [&] {
+            create_family();
+            append_family();
+        },
+        [&] {
+            for (const auto parent: parents) {
+                world.delete_entity(parent);
+            }
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+}
+
+void bench_scene(BenchReport& report, World& world, const std::size_t nb_entities) noexcept {
+    report.run(
+        "scene/load", nb_entities, nb_entities,
+        [&] {
+            scene_nb_entities = nb_entities;
+            create_entities(world, nb_entities, std::make_index_sequence<2>());
+            world.upgrade();
+        },
+        [&] {
+            world.load_scene(populated_scene);
+            world.upgrade();
+            world.upgrade();
+        },
+        [&] { clear_world(world); }
+    );
+}
+
+constexpr void bench_empty_threaded_sys(ThreadedSystem, World&) noexcept {
+}
+
+struct [[nodiscard]] FrameCounter final: public IResource {
+public:
+    constexpr FrameCounter(std::size_t new_nb_frames) noexcept:
+        nb_frames(new_nb_frames) {
+    }
+
+public:
+    std::size_t nb_frames;
+};
+
+void bench_frame_counter_sys(MainSystem, World& world) noexcept {
+    auto [frame_counter] = world.resource<FrameCounter>();
+    if (--frame_counter.nb_frames == 0) {
+        world.stop_run();
+    }
+}
+
+static std::size_t events_per_frame = 0;
+
+void bench_send_events_sys(MainSystem, World& world) noexcept {
+    auto [values] = world.resource<Events<float>>();
+    float sum = 0;
+    for (const auto value: values) {
+        sum += value;
+    }
+    bench_sink = sum;
+    for (std::size_t i = 0; i < events_per_frame; i++) {
+        values.send(static_cast<float>(i));
+    }
+}
+
+// Each frame reads the events of the previous one and sends nb_entities new ones.
+void bench_events(BenchReport& report, const std::size_t nb_entities) noexcept {
+    static constexpr std::size_t NB_FRAMES = 10;
+    report.run(
+        "events/send_and_read", nb_entities, nb_entities * NB_FRAMES,
+        [&] { events_per_frame = nb_entities; },
+        [] {
+            ZerEngine engine;
+            engine
+                .use_multithreading(false)
+                .add_events<float>()
+                .add_systems(MainSet({bench_send_events_sys}))
+                .run_frames(NB_FRAMES, 0.02f);
+        },
+        [] {}
+    );
+}
+
+void bench_threadpool(BenchReport& report) noexcept {
+    static constexpr std::size_t NB_FRAMES = 10'000;
+    if (std::thread::hardware_concurrency() < 2) {
+        std::println("threadpool/*: ignore, hardware_concurrency() < 2");
+        return;
+    }
+
+    report.run(
+        "threadpool/frame_without_threaded_sets", 0, NB_FRAMES,
+        [] {},
+        [] {
+            ZerEngine()
+                .use_multithreading(true)
+                .add_resource<FrameCounter>(NB_FRAMES)
+                .add_systems(MainSet({bench_frame_counter_sys}))
+                .run();
+        },
+        [] {}
+    );
+
+    report.run(
+        "threadpool/dispatch_8_systems", 0, NB_FRAMES,
+        [] {},
+        [] {
+            ZerEngine()
+                .use_multithreading(true)
+                .add_resource<FrameCounter>(NB_FRAMES)
+                .add_systems(MainSet({bench_frame_counter_sys}))
+                .add_systems(ThreadedSet({
+                    bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys,
+                    bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys
+                }))
+                .run();
+        },
+        [] {}
+    );
+
+    // Workers sleep on the condition variable between sets instead of spinning.
+    report.run(
+        "threadpool/dispatch_8_systems_no_spin", 0, NB_FRAMES,
+        [] {},
+        [] {
+            ZerEngine()
+                .use_multithreading(true)
+                .set_worker_spin_duration(std::chrono::microseconds(0))
+                .add_resource<FrameCounter>(NB_FRAMES)
+                .add_systems(MainSet({bench_frame_counter_sys}))
+                .add_systems(ThreadedSet({
+                    bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys,
+                    bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys, bench_empty_threaded_sys
+                }))
+                .run();
+        },
+        [] {}
+    );
+}
+
+static Entity bench_max_entity = 0;
+
+void bench_create_entity_sys(MainSystem, World& world) noexcept {
+    bench_max_entity = std::max(bench_max_entity, world.create_entity(Value<0>(0.0f)));
+}
+
+// Two Worlds stepped in turn on one thread (Executor jobs, scene staging): each must keep its own block of entity ids.
+void bench_alternating_worlds(BenchReport& report, const std::size_t nb_entities) noexcept {
+    report.run(
+        "entity/create_alternating_worlds", nb_entities, nb_entities * 2,
+        [] { bench_max_entity = 0; },
+        [&] {
+            ZerEngine engine_a;
+            ZerEngine engine_b;
+            auto& world_a = engine_a.use_multithreading(false).add_systems(MainSet({bench_create_entity_sys}));
+            auto& world_b = engine_b.use_multithreading(false).add_systems(MainSet({bench_create_entity_sys}));
+            for (std::size_t i = 0; i < nb_entities; i++) {
+                world_a.step(0.02f);
+                world_b.step(0.02f);
+            }
+        },
+        [&] {
+            // Ids lost at each switch would grow the dense tables indexed by entity (entity_locations, pending states).
+            if (bench_max_entity > nb_entities + 64) {
+                std::println("entity/create_alternating_worlds: id maximal {} pour {} entites par World, des ids sont perdus", bench_max_entity, nb_entities);
+            }
+        }
+    );
+}
+
+void bench_callback(CallbackSystem, World&, const Entity entity) noexcept {
+    bench_sink = static_cast<float>(entity);
+}
+
+void bench_use_callback_sys(MainSystem, World& world) noexcept {
+    world.use_callback(bench_callback, 0);
+    world.use_callback(independent_callback, bench_callback, 1);
+}
+
+// One World per frame, like the stages of stream_scene: the callback buffers of each World register a writer on this
+// thread and must leave nothing behind once destroyed, the cost per World stays flat.
+void bench_short_lived_worlds(BenchReport& report, const std::size_t nb_entities) noexcept {
+    const std::size_t nb_worlds = nb_entities / 100;
+    report.run(
+        "callbacks/short_lived_worlds", nb_entities, nb_worlds,
+        [] {},
+        [&] {
+            for (std::size_t i = 0; i < nb_worlds; i++) {
+                ZerEngine engine;
+                engine
+                    .use_multithreading(false)
+                    .add_systems(MainSet({bench_use_callback_sys}))
+                    .run_frames(1, 0.02f);
+            }
+        },
+        [] {}
+    );
+}
+
+void bench_main_sys(MainSystem, World& world) noexcept {
+    BenchReport report(bench_config);
+
+    for (const std::size_t nb_entities: {10'000uz, 100'000uz, 1'000'000uz}) {
+        bench_entities(report, world, nb_entities);
+        bench_queries(report, world, nb_entities);
+        bench_hierarchy(report, world, nb_entities);
+        bench_scene(report, world, nb_entities);
+        bench_events(report, nb_entities);
+        bench_alternating_worlds(report, nb_entities);
+        bench_short_lived_worlds(report, nb_entities);
+
+        // Each name is tested: a filter such as "iterate/3_components" does not match the "iterate/" prefix.
+        const bool is_iterate_enabled = std::ranges::any_of(std::views::iota(1uz, 9uz), [&](const std::size_t nb_components) {
+            return report.is_enabled(iterate_bench_name(nb_components));
+        });
+        if (is_iterate_enabled && nb_entities <= bench_config.max_entities) {
+            create_entities(world, nb_entities, std::make_index_sequence<8>());
+            world.upgrade();
+            bench_iteration<1>(report, world, nb_entities);
+            bench_iteration<2>(report, world, nb_entities);
+            bench_iteration<3>(report, world, nb_entities);
+            bench_iteration<4>(report, world, nb_entities);
+            bench_iteration<5>(report, world, nb_entities);
+            bench_iteration<6>(report, world, nb_entities);
+            bench_iteration<7>(report, world, nb_entities);
+            bench_iteration<8>(report, world, nb_entities);
+            clear_world(world);
+        }
+    }
+
+    bench_threadpool(report);
+
+    report.write_json();
+    world.stop_run();
+}
+
+[[nodiscard]] auto parse_size(std::string_view arg, std::size_t& value) noexcept -> bool {
+    return std::from_chars(arg.data(), arg.data() + arg.size(), value).ec == std::errc();
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--out" && has_value) {
+            bench_config.out_path = argv[++i];
+        } else if (arg == "--max-entities" && has_value && parse_size(argv[i + 1], bench_config.max_entities)) {
+            i++;
+        } else if (arg == "--repetitions" && has_value && parse_size(argv[i + 1], bench_config.repetitions) && bench_config.repetitions > 0) {
+            i++;
+        } else if (arg == "--filter" && has_value) {
+            bench_config.filter = argv[++i];
+        } else {
+            std::println("Usage: zerengine_bench [--out results.json] [--max-entities N] [--repetitions N] [--filter name]");
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    ZerEngine()
+        .use_multithreading(false)
+        .add_systems(MainSet({bench_main_sys}))
+        .run();
+
+    return 0;
+}
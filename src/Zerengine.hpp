@@ -1,23 +1,35 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <chrono>
 #include <concepts>
 #include <condition_variable>
+#include <coroutine>
 #include <cstddef>
 #include <cstdlib>
 #include <ctime>
+#include <format>
+#include <fstream>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <numeric>
 #include <optional>
+#include <queue>
 #include <print>
 #include <ranges>
 #include <set>
+#include <span>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <unordered_map>
@@ -25,6 +37,11 @@
 #include <utility>
 #include <vector>
 
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
 constexpr inline std::size_t ZERENGINE_VERSION_MAJOR = 25;
 constexpr inline std::size_t ZERENGINE_VERSION_MINOR = 3;
 constexpr inline std::size_t ZERENGINE_VERSION_PATCH = 2;
@@ -42,6 +59,22 @@ struct [[nodiscard]] Without final {};
 template <typename... Excludes>
 constexpr inline const Without<Excludes...> without;
 
+// query<Position, Opt<const Velocity>>(): yields a const Velocity* instead of a reference, nullptr when the entity has no Velocity.
+template <typename T>
+struct [[nodiscard]] Opt final {};
+
+// query<Transform>(with_parent<const Transform>): also yields the components of the parent of each entity.
+template <typename... ParentComps>
+struct [[nodiscard]] WithParent final {};
+template <typename... ParentComps>
+constexpr inline const WithParent<ParentComps...> with_parent;
+
+// query<Sprite>(order_by<&Sprite::z>): rows by ascending key, the key being a member or a function of one component.
+template <auto Key>
+struct [[nodiscard]] OrderBy final {};
+template <auto Key>
+constexpr inline const OrderBy<Key> order_by;
+
 struct [[nodiscard]] WithInactive final {};
 constexpr inline WithInactive with_inactive;
 
@@ -75,6 +108,56 @@ enum class CascadeMode: uint8_t {
     INSERT_AND_REMOVE,
 };
 
+// Archetype: stored in the entity archetype columns (default), fastest to iterate.
+// Sparse: stored in a sparse set keyed by entity, adding or removing it never moves the entity to another archetype.
+enum class Storage: uint8_t {
+    Archetype,
+    Sparse,
+};
+
+// struct PlayerDash final: public IComponent { static constexpr auto storage = Storage::Sparse; };
+template <typename T>
+[[nodiscard]] consteval auto get_component_storage() noexcept -> Storage {
+    if constexpr (requires { { std::remove_cv_t<T>::storage } -> std::convertible_to<Storage>; }) {
+        return std::remove_cv_t<T>::storage;
+    } else {
+        return Storage::Archetype;
+    }
+}
+
+template <typename T>
+constexpr inline bool is_sparse_component_v = get_component_storage<T>() == Storage::Sparse;
+
+template <typename T>
+struct [[nodiscard]] QueryTerm final {
+    using component_type = T;
+    using reference = T&;
+    static constexpr bool is_optional = false;
+};
+
+template <typename T>
+struct [[nodiscard]] QueryTerm<Opt<T>> final {
+    using component_type = T;
+    using reference = T*;
+    static constexpr bool is_optional = true;
+};
+
+template <typename T>
+using query_component_t = typename QueryTerm<T>::component_type;
+
+template <typename C, typename K>
+auto impl_order_component(K C::*) noexcept -> C;
+template <typename C, typename K>
+auto impl_order_component(K (*)(const C&)) noexcept -> C;
+template <typename C, typename K>
+auto impl_order_component(K (*)(const C&) noexcept) noexcept -> C;
+
+template <auto Key>
+using order_component_t = decltype(impl_order_component(Key));
+
+template <auto Key>
+using order_key_t = std::remove_cvref_t<std::invoke_result_t<decltype(Key), const order_component_t<Key>&>>;
+
 struct [[nodiscard]] IsInactive final: public IComponent, public WithCascadingInsert {};
 struct [[nodiscard]] DontDestroyOnLoad final: public IComponent, public WithCascadingInsert {};
 
@@ -137,6 +220,9 @@ constexpr inline const LateUnscaledFixedSystem late_unscaled_fixed_system;
 struct [[nodiscard]] CallbackSystem final {};
 constexpr inline const CallbackSystem callback_system;
 struct [[nodiscard]] SceneSystem final {};
+struct [[nodiscard]] SceneStreamSystem final {};
+struct [[nodiscard]] IndependentCallback final {};
+constexpr inline const IndependentCallback independent_callback;
 
 struct [[nodiscard]] OnAddComponentHook final {};
 constexpr inline const OnAddComponentHook on_add_component_hook;
@@ -190,7 +276,7 @@ concept IsResourceConcept = [] -> bool {
     static_assert(std::is_class_v<T>, "Impossible d'ajouter une Ressource qui ne soit pas une Classe");
     static_assert(std::derived_from<T, IResource>, "Impossible d'ajouter une Ressource qui n'implemente pas IResource");
     static_assert(std::is_final_v<T>, "Impossible d'ajouter une Ressource qui ne soit pas Final");
-    static_assert(std::move_constructible<T>, "Impossible d'ajouter une Ressource qui ne soit pas Moveable");
+    static_assert(std::move_constructible<std::remove_cv_t<T>>, "Impossible d'ajouter une Ressource qui ne soit pas Moveable");
     return true;
 }();
 
@@ -207,6 +293,7 @@ enum class RegistryMessageType: uint8_t {
     SET_ACTIVE,
     SET_INACTIVE,
     ADD_DONT_DESTROY_ON_LOAD,
+    CANCELLED,
 };
 
 class [[nodiscard]] RegistryMessage final {
@@ -249,10 +336,196 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+struct [[nodiscard]] ComponentInfo final {
+    const char* name;
+    std::size_t size;
+};
+
+// Process-wide: a Type is the same typeid hash in every World.
+class [[nodiscard]] ComponentInfos final {
+public:
+    template <typename... Ts>
+    static void emplace() noexcept {
+        (emplace_once<Ts>(), ...);
+    }
+
+    [[nodiscard]] static auto get(const Type type) noexcept -> std::optional<ComponentInfo> {
+        const std::unique_lock<std::mutex> lock(mtx);
+        if (auto infos_it = infos.find(type); infos_it != infos.end()) {
+            return infos_it->second;
+        }
+        return std::nullopt;
+    }
+
+private:
+    template <typename T>
+    static void emplace_once() noexcept {
+        static const bool is_registered = [] {
+            const std::unique_lock<std::mutex> lock(mtx);
+            infos.emplace(typeid(T).hash_code(), ComponentInfo{typeid(T).name(), sizeof(T)});
+            return true;
+        }();
+        (void)is_registered;
+    }
+
+private:
+    static inline std::mutex mtx;
+    static inline std::unordered_map<Type, ComponentInfo> infos;
+};
+
+// Every component stored in a column or a sparse set is built here, so its type is known to ComponentInfos
+// whatever the World it ends up in (transfers, streamed scenes, cascading inserts). Empty components are not allocated.
+template <typename T, typename... Args>
+[[nodiscard]] auto make_component([[maybe_unused]] Args&&... args) noexcept -> std::pair<Type, std::unique_ptr<IComponent>> {
+    ComponentInfos::emplace<T>();
+    if constexpr (std::is_empty_v<T>) {
+        return {typeid(T).hash_code(), nullptr};
+    } else {
+        return {typeid(T).hash_code(), std::make_unique<T>(std::forward<Args>(args)...)};
+    }
+}
+
+// Misuses detected by the engine (a component added twice, a deleted entity...), reported from any thread without waiting.
+// The first messages of each call site are queued per frame, the others only counted, then written to std::cerr by flush() after the last upgrade of the frame.
+class [[nodiscard]] Diagnostics final {
+public:
+    // One per call site of ZERENGINE_DIAGNOSTIC, linked once without lock.
+    class [[nodiscard]] Counter final {
+    friend class Diagnostics;
+    public:
+        Counter(const char* const new_message) noexcept:
+            message(new_message),
+            next(counters.load(std::memory_order_relaxed)) {
+            while (!counters.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+
+    private:
+        const char* const message;
+        std::atomic<std::size_t> nb_reports {0};
+        std::atomic<std::size_t> nb_frame_reports {0};
+        std::atomic<std::size_t> nb_frame_messages {0};
+        Counter* next;
+    };
+
+public:
+    // False once the quota of the call site is reached for this frame: the message is then counted but never formatted.
+    [[nodiscard]] static auto count(Counter& counter) noexcept -> bool {
+        counter.nb_reports.fetch_add(1, std::memory_order_relaxed);
+        return counter.nb_frame_reports.fetch_add(1, std::memory_order_relaxed) < max_messages_per_frame.load(std::memory_order_relaxed);
+    }
+
+    // Never waits: while another thread holds the queue, the message is dropped (and still counted).
+    static void report(Counter& counter, std::string&& message) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+        if (lock.owns_lock()) {
+            messages.emplace_back(std::move(message));
+            counter.nb_frame_messages.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Process-wide: the quotas of the call sites are per flush. A ZerEngine flushes after each frame, an Executor once per
+    // round of frames over its engines. Serialized, the output of two flushes never interleaves.
+    static void flush() noexcept {
+        const std::unique_lock<std::mutex> flush_lock(flush_mtx);
+        std::vector<std::string> flushed_messages;
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            flushed_messages.swap(messages);
+        }
+        for (const auto& message: flushed_messages) {
+            std::cerr << message << '\n';
+        }
+        for (auto counter = counters.load(std::memory_order_acquire); counter != nullptr; counter = counter->next) {
+            const auto nb_frame_reports = counter->nb_frame_reports.exchange(0, std::memory_order_relaxed);
+            const auto nb_frame_messages = counter->nb_frame_messages.exchange(0, std::memory_order_relaxed);
+            if (nb_frame_reports > nb_frame_messages) {
+                std::cerr << std::format("ZerEngine::Diagnostics - {} message(s) non affiche(s): {}", nb_frame_reports - nb_frame_messages, counter->message) << '\n';
+            }
+        }
+    }
+
+    static void set_max_messages_per_frame(const std::size_t new_max_messages_per_frame) noexcept {
+        max_messages_per_frame.store(new_max_messages_per_frame, std::memory_order_relaxed);
+    }
+
+    // Reports of each call site since the start of the process, by message format.
+    [[nodiscard]] static auto get_report_counts() noexcept -> std::vector<std::pair<const char*, std::size_t>> {
+        std::vector<std::pair<const char*, std::size_t>> report_counts;
+        for (auto counter = counters.load(std::memory_order_acquire); counter != nullptr; counter = counter->next) {
+            report_counts.emplace_back(counter->message, counter->nb_reports.load(std::memory_order_relaxed));
+        }
+        return report_counts;
+    }
+
+private:
+    static inline std::atomic<Counter*> counters {nullptr};
+    static inline std::atomic<std::size_t> max_messages_per_frame {4};
+    static inline std::mutex mtx;
+    static inline std::mutex flush_mtx;
+    static inline std::vector<std::string> messages;
+};
+
+// With ZERENGINE_NO_CHECKS, the validation of the commands is compiled out: only the guards needed by the deferred commands remain
+// (an entity deleted by another system of the same frame), the other misuses are undefined behavior.
+#ifdef ZERENGINE_NO_CHECKS
+    constexpr inline bool ZERENGINE_HAS_CHECKS = false;
+    #define ZERENGINE_DIAGNOSTIC(...)
+#else
+    constexpr inline bool ZERENGINE_HAS_CHECKS = true;
+    #define ZERENGINE_DIAGNOSTIC(message, ...) { static Diagnostics::Counter diagnostic_counter(message); if (Diagnostics::count(diagnostic_counter)) { Diagnostics::report(diagnostic_counter, std::format(message __VA_OPT__(,) __VA_ARGS__)); } }
+#endif
+
+struct [[nodiscard]] ArchetypeMemoryStats final {
+    std::vector<Type> signature;
+    std::size_t nb_entities;
+    std::size_t component_bytes;
+    std::size_t overhead_bytes;
+    std::size_t empty_slot_bytes;
+};
+
+// Estimated heap usage of a World, in bytes. Empty slots are already included in overhead_bytes.
+struct [[nodiscard]] MemoryStats final {
+public:
+    [[nodiscard]] constexpr auto total_bytes() const noexcept -> std::size_t {
+        return component_bytes + overhead_bytes + entity_location_bytes + late_upgrade_bytes + hierarchy_bytes + resource_bytes;
+    }
+
+public:
+    std::vector<ArchetypeMemoryStats> archetypes;
+    std::size_t nb_entities = 0;
+    std::size_t component_bytes = 0;
+    std::size_t overhead_bytes = 0;
+    std::size_t empty_slot_bytes = 0;
+    std::size_t entity_location_bytes = 0;
+    std::size_t late_upgrade_bytes = 0;
+    std::size_t hierarchy_bytes = 0;
+    std::size_t resource_bytes = 0;
+};
+
+// Node based hash containers: one node (next pointer + value) per element, plus the bucket array.
+template <typename HashContainer>
+[[nodiscard]] constexpr auto hash_container_bytes(const HashContainer& container) noexcept -> std::size_t {
+    return container.size() * (sizeof(void*) + sizeof(typename HashContainer::value_type)) + container.bucket_count() * sizeof(void*);
+}
+
+template <typename HashContainer>
+[[nodiscard]] constexpr auto hash_container_empty_slot_bytes(const HashContainer& container) noexcept -> std::size_t {
+    return (container.bucket_count() - std::min(container.size(), container.bucket_count())) * sizeof(void*);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+// Index of an archetype in the arena of its Registry.
+using ArchetypeId = uint32_t;
+constexpr inline ArchetypeId NO_ARCHETYPE = std::numeric_limits<ArchetypeId>::max();
+constexpr inline ArchetypeId ROOT_ARCHETYPE = 0;
+
 class [[nodiscard]] Archetype final {
 friend class Registry;
 friend class LiteArchetype;
 friend class LateUpgrade;
+friend class World;
 template <typename... Ts>
 friend class Query;
 public:
@@ -260,21 +533,17 @@ public:
         nb_archetypes++;
     }
 
-    Archetype(const std::shared_ptr<Archetype>& old_archetype, const Type new_type) noexcept:
-        types(std::move([](const std::shared_ptr<Archetype>& old_archetype, const Type new_type) {
-            auto new_types = old_archetype->types;
+    // The future types of the previous archetypes are updated by Registry::emplace_archetype().
+    Archetype(const Archetype& old_archetype, const ArchetypeId old_archetype_id, const Type new_type) noexcept:
+        types(std::move([](const Archetype& old_archetype, const Type new_type) {
+            auto new_types = old_archetype.types;
             new_types.emplace(new_type);
             return new_types;
         } (old_archetype, new_type))),
-        previous_archetype(old_archetype) {
+        column_types(types.begin(), types.end()),
+        columns(column_types.size()),
+        previous_archetype(old_archetype_id) {
         nb_archetypes++;
-        auto old_archetype_rec = old_archetype;
-        old_archetype->future_types.emplace(new_type);
-        while (!old_archetype_rec->previous_archetype.expired()) {
-            auto old_previous_archetype = old_archetype_rec->previous_archetype.lock();
-            old_previous_archetype->future_types.emplace(new_type);
-            old_archetype_rec = old_previous_archetype;
-        }
     }
 
     ~Archetype() {
@@ -282,41 +551,176 @@ public:
     }
 
 private:
-    constexpr void emplace_entity(const Entity entity) noexcept {
-        entity_components.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(entity),
-            std::forward_as_tuple()
-        );
+    [[nodiscard]] constexpr auto emplace_entity(const Entity entity) noexcept -> std::size_t {
+        entities.emplace_back(entity);
+        is_row_order_dirty.store(true, std::memory_order_relaxed);
+        return entities.size() - 1;
+    }
+
+    // Both column lists are sorted: moves every shared column of old_row, takes new_component for the missing one.
+    [[nodiscard]] constexpr auto move_entity(Archetype& old_archetype, const std::size_t old_row, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept -> std::size_t {
+        entities.emplace_back(old_archetype.entities[old_row]);
+        is_row_order_dirty.store(true, std::memory_order_relaxed);
+        std::size_t old_column = 0;
+        for (std::size_t new_column = 0; new_column < column_types.size(); new_column++) {
+            while (old_column < old_archetype.column_types.size() && old_archetype.column_types[old_column] < column_types[new_column]) {
+                old_column++;
+            }
+            if (old_column < old_archetype.column_types.size() && old_archetype.column_types[old_column] == column_types[new_column]) {
+                columns[new_column].emplace_back(std::move(old_archetype.columns[old_column][old_row]));
+            } else {
+                columns[new_column].emplace_back(std::move(new_component.second));
+            }
+        }
+        return entities.size() - 1;
     }
 
-    constexpr void move_entity_with(const std::shared_ptr<Archetype>& old_archetype, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept {
-        entity_components.insert(std::move(old_archetype->entity_components.extract(entity)));
-        if (new_component.second != nullptr) {
-            entity_components.at(entity).emplace(std::move(new_component));
+    // Same types: moves every row of source at the end, the columns are swapped when this archetype is empty.
+    constexpr void append_rows(Archetype& source) noexcept {
+        is_row_order_dirty.store(true, std::memory_order_relaxed);
+        source.nb_ordered_rows = 0;
+        source.moved_rows.clear();
+        if (entities.empty()) {
+            entities.swap(source.entities);
+            columns.swap(source.columns);
+            return;
+        }
+        entities.insert(entities.end(), source.entities.begin(), source.entities.end());
+        source.entities.clear();
+        for (std::size_t column = 0; column < columns.size(); column++) {
+            columns[column].insert(columns[column].end(), std::make_move_iterator(source.columns[column].begin()), std::make_move_iterator(source.columns[column].end()));
+            source.columns[column].clear();
         }
     }
 
-    constexpr void move_entity_without(const std::shared_ptr<Archetype>& old_archetype, const Entity entity, const Type new_type) noexcept {
-        entity_components.insert(std::move(old_archetype->entity_components.extract(entity)));
-        entity_components.at(entity).erase(new_type);
+    // Swap and pop: returns the entity moved from the last row into row, if any.
+    [[nodiscard]] constexpr auto erase_row(const std::size_t row) noexcept -> std::optional<Entity> {
+        const auto last_row = entities.size() - 1;
+        for (auto& column: columns) {
+            if (row != last_row) {
+                column[row] = std::move(column[last_row]);
+            }
+            column.pop_back();
+        }
+        entities[row] = entities[last_row];
+        entities.pop_back();
+        nb_ordered_rows = std::min(nb_ordered_rows, entities.size());
+        if (row != last_row) {
+            is_row_order_dirty.store(true, std::memory_order_relaxed);
+            if (row < nb_ordered_rows) {
+                // Past half of the ordered rows, sorting them all again costs less than merging.
+                if (moved_rows.size() < nb_ordered_rows / 2) {
+                    moved_rows.emplace_back(row);
+                } else {
+                    nb_ordered_rows = 0;
+                    moved_rows.clear();
+                }
+            }
+            return entities[row];
+        }
+        return std::nullopt;
     }
 
-    constexpr void delete_entity(const Entity entity) noexcept {
-        entity_components.erase(entity);
+    // Row i takes the old row order[i], the rows before first_row are already in place (order[i] == i).
+    // Only the rows from first_row are moved, through scratch vectors whose capacity is reused by the next call.
+    constexpr void permute_rows(const std::vector<std::size_t>& order, const std::size_t first_row, std::vector<Entity>& scratch_entities, std::vector<std::unique_ptr<IComponent>>& scratch_column) noexcept {
+        scratch_entities.assign(entities.begin() + first_row, entities.end());
+        for (std::size_t row = first_row; row < order.size(); row++) {
+            entities[row] = scratch_entities[order[row] - first_row];
+        }
+
+        for (auto& column: columns) {
+            scratch_column.assign(std::make_move_iterator(column.begin() + first_row), std::make_move_iterator(column.end()));
+            for (std::size_t row = first_row; row < order.size(); row++) {
+                column[row] = std::move(scratch_column[order[row] - first_row]);
+            }
+        }
+        scratch_column.clear();
     }
 
-    [[nodiscard]] constexpr auto get_component(const Entity entity, const Type type) noexcept -> const std::unique_ptr<IComponent>& {
-        return entity_components.at(entity).at(type);
+    [[nodiscard]] constexpr auto get_column(const Type type) noexcept -> std::vector<std::unique_ptr<IComponent>>* {
+        if (auto column_types_it = std::lower_bound(column_types.begin(), column_types.end(), type); column_types_it != column_types.end() && *column_types_it == type) {
+            return &columns[std::distance(column_types.begin(), column_types_it)];
+        }
+        return nullptr;
     }
 
 public:
-    static inline std::size_t nb_archetypes = 0;
+    static inline std::atomic<std::size_t> nb_archetypes = 0;
     const std::set<Type> types;
+    const std::vector<Type> column_types;
     std::unordered_set<Type> future_types;
-    std::unordered_map<Entity, std::unordered_map<Type, std::unique_ptr<IComponent>>> entity_components;
-    const std::weak_ptr<Archetype> previous_archetype;
-    std::map<Type, std::shared_ptr<Archetype>> next_archetypes;
+    std::vector<Entity> entities;
+    std::vector<std::vector<std::unique_ptr<IComponent>>> columns;
+    const ArchetypeId previous_archetype = NO_ARCHETYPE;
+    std::map<Type, ArchetypeId> next_archetypes;
+    ArchetypeId id = ROOT_ARCHETYPE;
+    // Rows added, moved or found out of order by Registry::order_rows() since the last Registry::apply_row_orders().
+    std::atomic<bool> is_row_order_dirty = false;
+    // Keys edited in place, found by Registry::order_rows(): the next sort takes every row again.
+    std::atomic<bool> is_row_order_lost = false;
+    // The rows before nb_ordered_rows, but the moved_rows filled by a swap and pop, are still in key order.
+    std::size_t nb_ordered_rows = 0;
+    std::vector<std::size_t> moved_rows;
+};
+
+struct [[nodiscard]] EntityLocation final {
+    Archetype* archetype = nullptr;
+    std::size_t row = 0;
+};
+
+class [[nodiscard]] SparseSet final {
+friend class Registry;
+friend class World;
+template <typename... Ts>
+friend class Query;
+private:
+    [[nodiscard]] constexpr auto contains(const Entity entity) const noexcept -> bool {
+        return entity < sparse.size() && sparse[entity] != npos;
+    }
+
+    [[nodiscard]] constexpr auto get(const Entity entity) const noexcept -> IComponent* {
+        return components[sparse[entity]].get();
+    }
+
+    constexpr void emplace(const Entity entity, std::unique_ptr<IComponent>&& component) noexcept {
+        if (entity >= sparse.size()) {
+            sparse.resize(entity + 1, npos);
+        }
+        sparse[entity] = entities.size();
+        entities.emplace_back(entity);
+        components.emplace_back(std::move(component));
+    }
+
+    [[nodiscard]] constexpr auto extract(const Entity entity) noexcept -> std::unique_ptr<IComponent> {
+        auto component = std::move(components[sparse[entity]]);
+        erase(entity);
+        return component;
+    }
+
+    // Swap and pop, like Archetype::erase_row.
+    constexpr void erase(const Entity entity) noexcept {
+        const auto index = sparse[entity];
+        const auto last_index = entities.size() - 1;
+        if (index != last_index) {
+            entities[index] = entities[last_index];
+            components[index] = std::move(components[last_index]);
+            sparse[entities[index]] = index;
+        }
+        entities.pop_back();
+        components.pop_back();
+        sparse[entity] = npos;
+    }
+
+    [[nodiscard]] constexpr auto size() const noexcept -> std::size_t {
+        return entities.size();
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> sparse;
+    std::vector<Entity> entities;
+    std::vector<std::unique_ptr<IComponent>> components;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -326,42 +730,76 @@ class [[nodiscard]] Query final {
 friend class Registry;
 friend class LiteRegistry;
 private:
-    constexpr Query(const std::unordered_set<std::shared_ptr<Archetype>>& newArchs) noexcept:
-        archs(newArchs) {
+    constexpr Query(const std::vector<std::unique_ptr<Archetype>>& new_archetypes, std::vector<ArchetypeId>&& newArchs, const std::size_t new_nb_rows, const std::array<const SparseSet*, sizeof...(Ts)>& new_sparse_columns, std::vector<const SparseSet*>&& new_sparse_filters, std::vector<const SparseSet*>&& new_sparse_excludes) noexcept:
+        archetypes(new_archetypes),
+        archs(std::move(newArchs)),
+        nb_rows(new_nb_rows),
+        sparse_columns(new_sparse_columns),
+        sparse_filters(std::move(new_sparse_filters)),
+        sparse_excludes(std::move(new_sparse_excludes)) {
     }
 
 public:
     [[nodiscard]] constexpr auto empty() const noexcept -> bool {
-        return archs.empty();
+        if (!has_sparse_terms()) {
+            return nb_rows == 0;
+        }
+        return !(begin() != end());
     }
 
+    // Counted when the query is built, unless sparse terms filter the rows.
     [[nodiscard]] constexpr auto size() const noexcept -> std::size_t {
+        if (!has_sparse_terms()) {
+            return nb_rows;
+        }
         std::size_t new_size = 0;
-        for (const auto& archetype: archs) {
-            new_size += archetype->entity_components.size();
+        for (const auto archetype_id: archs) {
+            for (const auto entity: archetypes[archetype_id]->entities) {
+                if (accept(entity)) {
+                    new_size++;
+                }
+            }
         }
         return new_size;
     }
 
+private:
+    [[nodiscard]] constexpr auto has_sparse_terms() const noexcept -> bool {
+        return !sparse_filters.empty() || !sparse_excludes.empty();
+    }
+
+    [[nodiscard]] constexpr auto accept(const Entity entity) const noexcept -> bool {
+        for (const auto sparse_set: sparse_filters) {
+            if (!sparse_set->contains(entity)) {
+                return false;
+            }
+        }
+        for (const auto sparse_set: sparse_excludes) {
+            if (sparse_set->contains(entity)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
 private:
     class [[nodiscard]] QueryIterator final {
     friend class Query;
     public:
         using iterator_category = std::forward_iterator_tag;
-        using value_type = std::tuple<const Entity, Ts&...>;
+        using value_type = std::tuple<const Entity, typename QueryTerm<Ts>::reference...>;
         using element_type = value_type;
         using pointer = value_type*;
         using reference = value_type&;
         using difference_type = std::ptrdiff_t;
 
     public:
-        QueryIterator(const std::unordered_set<std::shared_ptr<Archetype>>& newArchs, std::unordered_set<std::shared_ptr<Archetype>>::const_iterator newArchsIt) noexcept:
+        QueryIterator(const Query& new_query, std::vector<ArchetypeId>::const_iterator newArchsIt) noexcept:
             archsIt(newArchsIt),
-            archs(newArchs) {
-            if (archsIt != newArchs.end()) {
-                if (!(*archsIt)->entity_components.empty()) {
-                    entsIt = (*archsIt)->entity_components.begin();
-                }
+            query(new_query) {
+            if (archsIt != query.archs.end()) {
+                load_columns();
+                skip_rejected_rows();
             }
         }
 
@@ -374,198 +812,542 @@ private:
         ~QueryIterator() = default;
 
         [[nodiscard]] constexpr auto operator *() const noexcept -> value_type {
-            return std::tuple_cat(std::forward_as_tuple(entsIt->first), std::forward_as_tuple(*static_cast<Ts*>((*archsIt)->get_component(entsIt->first, typeid(Ts).hash_code()).get())...));
+            return get_row(std::index_sequence_for<Ts...>());
         }
 
         constexpr auto operator ++() noexcept -> QueryIterator& {
-            entsIt++;
-            if (entsIt == (*archsIt)->entity_components.end()) {
+            next_row();
+            skip_rejected_rows();
+            return *this;
+        }
+
+        [[nodiscard]] friend constexpr auto operator !=(const QueryIterator& a, const QueryIterator& b) noexcept -> bool {
+            return a.archsIt != b.archsIt || a.row != b.row;
+        }
+
+    private:
+        constexpr void next_row() noexcept {
+            row++;
+            if (row == archetype->entities.size()) {
                 archsIt++;
-                if (archsIt != archs.end()) {
-                    entsIt = (*archsIt)->entity_components.begin();
+                row = 0;
+                if (archsIt != query.archs.end()) {
+                    load_columns();
                 }
             }
-            return *this;
         }
 
-        [[nodiscard]] friend constexpr auto operator !=(const QueryIterator& a, const QueryIterator& b) noexcept -> bool {
-            return a.archsIt != b.archsIt;
+        // Sparse components are not part of the archetype: their rows are filtered one by one.
+        constexpr void skip_rejected_rows() noexcept {
+            if (query.has_sparse_terms()) {
+                while (archsIt != query.archs.end() && !query.accept(archetype->entities[row])) {
+                    next_row();
+                }
+            }
+        }
+
+        // Columns are resolved once per archetype, rows are then plain indices.
+        constexpr void load_columns() noexcept {
+            archetype = query.archetypes[*archsIt].get();
+            columns = {load_column<Ts>()...};
+        }
+
+        // An optional column missing from the archetype stays null for all its rows.
+        template <typename T>
+        [[nodiscard]] constexpr auto load_column() const noexcept -> std::unique_ptr<IComponent>* {
+            using Component = query_component_t<T>;
+            if constexpr (is_sparse_component_v<Component>) {
+                return nullptr;
+            } else if constexpr (QueryTerm<T>::is_optional) {
+                auto column = archetype->get_column(typeid(Component).hash_code());
+                return column ? column->data() : nullptr;
+            } else {
+                return archetype->get_column(typeid(Component).hash_code())->data();
+            }
+        }
+
+        template <std::size_t... Is>
+        [[nodiscard]] constexpr auto get_row(std::index_sequence<Is...>) const noexcept -> value_type {
+            const auto entity = archetype->entities[row];
+            return value_type(entity, get_component<Ts, Is>(entity)...);
+        }
+
+        template <typename T, std::size_t I>
+        [[nodiscard]] constexpr auto get_component(const Entity entity) const noexcept -> typename QueryTerm<T>::reference {
+            using Component = query_component_t<T>;
+            if constexpr (QueryTerm<T>::is_optional) {
+                if constexpr (is_sparse_component_v<Component>) {
+                    if (query.sparse_columns[I] == nullptr || !query.sparse_columns[I]->contains(entity)) {
+                        return nullptr;
+                    }
+                    return static_cast<Component*>(query.sparse_columns[I]->get(entity));
+                } else {
+                    return columns[I] ? static_cast<Component*>(columns[I][row].get()) : nullptr;
+                }
+            } else if constexpr (is_sparse_component_v<Component>) {
+                return *static_cast<Component*>(query.sparse_columns[I]->get(entity));
+            } else {
+                return *static_cast<Component*>(columns[I][row].get());
+            }
         }
 
     private:
-        std::unordered_set<std::shared_ptr<Archetype>>::const_iterator archsIt;
-        std::unordered_map<Entity, std::unordered_map<Type, std::unique_ptr<IComponent>>>::iterator entsIt;
-        const std::unordered_set<std::shared_ptr<Archetype>>& archs;
+        std::vector<ArchetypeId>::const_iterator archsIt;
+        Archetype* archetype = nullptr;
+        std::size_t row {0};
+        std::array<std::unique_ptr<IComponent>*, sizeof...(Ts)> columns {};
+        const Query& query;
     };
 
 public:
     [[nodiscard]] constexpr auto begin() const noexcept -> QueryIterator {
-        return {archs, archs.begin()};
+        return {*this, archs.begin()};
     }
 
     [[nodiscard]] constexpr auto end() const noexcept -> QueryIterator {
-        return {archs, archs.end()};
+        return {*this, archs.end()};
     }
 
 private:
-    const std::unordered_set<std::shared_ptr<Archetype>> archs;
+    const std::vector<std::unique_ptr<Archetype>>& archetypes;
+    const std::vector<ArchetypeId> archs;
+    const std::size_t nb_rows;
+    const std::array<const SparseSet*, sizeof...(Ts)> sparse_columns;
+    const std::vector<const SparseSet*> sparse_filters;
+    const std::vector<const SparseSet*> sparse_excludes;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-class [[nodiscard]] Registry final {
-friend class World;
-friend class LateUpgrade;
-private:
-    [[nodiscard]] constexpr auto get_entity_token() noexcept -> Entity {
-        auto token = last_entity_token++;
-
-        if (!entity_tokens.empty()) {
-            last_entity_token--;
-            token = entity_tokens.back();
-            entity_tokens.pop_back();
-            return token;
-        }
-
-        while (entArch.contains(token)) {
-            token = last_entity_token++;
-        }
+// Rows of a query resolved once when it is built: joined with their parent (World::query(with_parent<...>)) or ordered by a key (World::query(order_by<...>)).
+template <typename... Ts>
+class [[nodiscard]] MaterializedQuery final {
+friend class Registry;
+public:
+    using value_type = std::tuple<const Entity, Ts...>;
 
-        return token;
+private:
+    MaterializedQuery(std::vector<value_type>&& new_rows) noexcept:
+        rows(std::move(new_rows)) {
     }
 
 public:
-    constexpr void create_entity(const Entity entity) noexcept {
-        if (entArch.contains(entity)) {
-            std::cerr << "Registry::create_entity(): Impossible d'ajouter deux fois la meme entité: Entity[" << entity << "]" << std::endl;
-            return;
-        }
+    [[nodiscard]] constexpr auto empty() const noexcept -> bool {
+        return rows.empty();
+    }
 
-        entArch.emplace(entity, archetype_root);
-        archetype_root->emplace_entity(entity);
+    [[nodiscard]] constexpr auto size() const noexcept -> std::size_t {
+        return rows.size();
     }
 
-    void add_components(const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept {
-        auto entArchIt = entArch.find(entity);
-        if (entArchIt == entArch.end()) {
-            std::cerr << "Registry::add_components(): Impossible d'ajouter un composant sur une entite inexistante: Entity[" << entity << "]" << std::endl;
-            return;
-        }
+    [[nodiscard]] constexpr auto begin() const noexcept -> std::vector<value_type>::const_iterator {
+        return rows.begin();
+    }
 
-        if (entArchIt->second->types.contains(new_component.first)) {
-            std::cerr << "Registry::add_components(): Impossible d'ajouter deux fois le meme composant sur une entite: Entity[" << entity << "]" << std::endl;
-            return;
-        }
+    [[nodiscard]] constexpr auto end() const noexcept -> std::vector<value_type>::const_iterator {
+        return rows.end();
+    }
 
-        auto old_archetype = entArchIt->second;
+private:
+    const std::vector<value_type> rows;
+};
 
-        if (auto next_archetype_it = old_archetype->next_archetypes.find(new_component.first); next_archetype_it != old_archetype->next_archetypes.end()) {
-            entArchIt->second = next_archetype_it->second;
-        } else {
-            if (!old_archetype->types.empty() && *std::prev(old_archetype->types.end()) >= new_component.first) {
-                if (*std::prev(old_archetype->types.end()) > new_component.first) {
-                    auto ordered_types = old_archetype->types;
-                    ordered_types.emplace(new_component.first);
-                    create_branch(ordered_types, entity);
-                }
-            } else {
-                entArchIt->second = old_archetype->next_archetypes.emplace(
-                    new_component.first,
-                    std::make_shared<Archetype>(old_archetype, new_component.first)
-                ).first->second;
-            }
-        }
-        entArchIt->second->move_entity_with(old_archetype, entity, std::move(new_component));
+///////////////////////////////////////////////////////////////////////////////////
 
-        graph_readjustement(old_archetype);
-    }
+// Fresh ids [next, end) reserved by a thread for one EntityAllocator.
+struct [[nodiscard]] EntityBlock final {
+    std::size_t allocator_id = 0;
+    Entity next = 0;
+    Entity end = 0;
+};
 
-    void remove_components(const Entity entity, const std::vector<Type>& new_types) noexcept {
-        auto entArchIt = entArch.find(entity);
-        if (entArchIt == entArch.end()) {
-            std::cerr << "Registry::remove_components(): Impossible de supprimer un composant sur une entite inexistante: Entity[" << entity << "]" << std::endl;
-            return;
+// Lock-free entity id allocation, safe to call from parallel systems.
+// Fresh ids are reserved by blocks of BLOCK_SIZE per thread, so the shared counter is only touched once per block.
+// Recycled ids are released during the upgrade and published at its end: between two upgrades the free list is only popped.
+class [[nodiscard]] EntityAllocator final {
+friend class Registry;
+private:
+    // The blocks of the last allocators used by a thread, most recent first: a thread switching between Worlds (Executor
+    // jobs, scene staging, transfer) keeps one block per World. An evicted block gives its unused ids back to its allocator.
+    struct [[nodiscard]] ThreadBlocks final {
+        ~ThreadBlocks() noexcept {
+            for (const auto& block: blocks) {
+                give_back(block);
+            }
         }
 
-        for (auto new_type: new_types) {
-            if (!entArchIt->second->types.contains(new_type)) {
-                std::cerr << "Registry::remove_components(): Impossible de supprimer un composant inexistant sur une entite: Entity[" << entity << "]" << std::endl;
-                return;
+        [[nodiscard]] auto get(const std::size_t allocator_id) noexcept -> EntityBlock& {
+            if (blocks.front().allocator_id == allocator_id) {
+                return blocks.front();
             }
-
-            auto old_archetype = entArchIt->second;
-
-            if (*std::prev(old_archetype->types.end()) == new_type) {
-                entArchIt->second = old_archetype->previous_archetype.lock();
-            } else {
-                auto ordered_types = old_archetype->types;
-                ordered_types.erase(new_type);
-                create_branch(ordered_types, entity);
+            auto block_it = std::ranges::find(blocks, allocator_id, &EntityBlock::allocator_id);
+            if (block_it == blocks.end()) {
+                block_it = std::prev(blocks.end());
+                give_back(*block_it);
+                *block_it = {allocator_id, 0, 0};
             }
-            entArchIt->second->move_entity_without(old_archetype, entity, new_type);
-
-            graph_readjustement(old_archetype);
+            std::rotate(blocks.begin(), block_it, std::next(block_it));
+            return blocks.front();
         }
-    }
 
-    constexpr void delete_entity(const Entity entity) noexcept {
-        if (!entArch.contains(entity)) {
-            std::cerr << "Registry::delete_entity(): Impossible de supprimer une entite inexistante: Entity[" << entity << "]" << std::endl;
-            return;
-        }
+        std::array<EntityBlock, 8> blocks {};
+    };
 
-        detach_children(entity);
-        remove_parent(entity);
+private:
+    EntityAllocator() noexcept:
+        allocator_id(next_allocator_id.fetch_add(1, std::memory_order_relaxed)) {
+        auto& allocators = get_allocators();
+        const std::unique_lock<std::mutex> lock(allocators.mtx);
+        allocators.by_id.emplace(allocator_id, this);
+    }
 
-        auto old_archetype = entArch.find(entity)->second;
+    ~EntityAllocator() noexcept {
+        auto& allocators = get_allocators();
+        const std::unique_lock<std::mutex> lock(allocators.mtx);
+        allocators.by_id.erase(allocator_id);
+    }
 
-        old_archetype->delete_entity(entity);
-        entity_tokens.push_back(entity);
-        entArch.erase(entity);
-        graph_readjustement(old_archetype);
+    struct [[nodiscard]] Allocators final {
+        std::mutex mtx;
+        std::unordered_map<std::size_t, EntityAllocator*> by_id;
+    };
+
+    // Never destroyed: Worlds and thread blocks may outlive the other static objects.
+    [[nodiscard]] static auto get_allocators() noexcept -> Allocators& {
+        static auto* const allocators = new Allocators();
+        return *allocators;
     }
 
-    [[nodiscard]] constexpr auto is_entity_exist(const Entity entity) const noexcept -> bool {
-        return entArch.contains(entity);
+    [[nodiscard]] static auto get_thread_blocks() noexcept -> ThreadBlocks& {
+        static thread_local ThreadBlocks thread_blocks;
+        return thread_blocks;
     }
 
-    [[nodiscard]] auto has_components(const Entity entity, const std::initializer_list<Type>& types) const noexcept -> bool {
-        auto entArchIt = entArch.find(entity);
-        if (entArchIt == entArch.end()) {
-            // std::cerr << "Registry::has_component(): L'entite n'existe pas/plus [" << entity << "]" << std::endl;
-            return false;
-        }
-        if (!entArchIt->second) {
-            std::cerr << "Registry::has_component(): le noeud a expirer ?!?" << std::endl;
-            return false;
+    // Rare path (eviction, thread exit): the ids are published by the next upgrade of their allocator, if it still exists.
+    static void give_back(const EntityBlock& block) noexcept {
+        if (block.allocator_id == 0 || block.next == block.end) {
+            return;
         }
-        for (const auto& type: types) {
-            if (!entArchIt->second->types.contains(type)) {
-                return false;
-            }
+        auto& allocators = get_allocators();
+        const std::unique_lock<std::mutex> lock(allocators.mtx);
+        if (auto allocators_it = allocators.by_id.find(block.allocator_id); allocators_it != allocators.by_id.end()) {
+            allocators_it->second->given_back_blocks.emplace_back(block);
+            allocators_it->second->has_given_back_blocks.store(true, std::memory_order_release);
         }
-        return true;
     }
 
-    [[nodiscard]] auto get(const Entity entity, const Type type) noexcept -> std::optional<std::reference_wrapper<std::unique_ptr<IComponent>>> {
-        if (auto entArchIt = entArch.find(entity); entArchIt != entArch.end()) {
-            if (auto entity_components_it = entArchIt->second->entity_components.find(entity); entity_components_it != entArchIt->second->entity_components.end()) {
-                if (auto components_it = entity_components_it->second.find(type); components_it != entity_components_it->second.end()) {
-                    return components_it->second;
-                }
+    [[nodiscard]] auto allocate() noexcept -> Entity {
+        auto top = free_top.load(std::memory_order_acquire);
+        while (top > 0) {
+            if (free_top.compare_exchange_weak(top, top - 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return free_entities[top - 1];
             }
         }
-        return std::nullopt;
+
+        auto& block = get_thread_blocks().get(allocator_id);
+        if (block.next == block.end) {
+            block.next = next_block.fetch_add(BLOCK_SIZE, std::memory_order_relaxed);
+            block.end = block.next + BLOCK_SIZE;
+        }
+        return block.next++;
     }
 
-    [[nodiscard]] constexpr auto get_all_components_types(const Entity entity) const noexcept -> const std::set<Type>& {
-        return entArch.at(entity)->types;
+    // Upgrade only.
+    constexpr void release(const Entity entity) noexcept {
+        released_entities.emplace_back(entity);
+    }
+
+    // Upgrade only: no allocate() runs concurrently, the ids already popped are dropped.
+    void publish() noexcept {
+        free_entities.resize(free_top.load(std::memory_order_relaxed));
+        free_entities.insert(free_entities.end(), released_entities.begin(), released_entities.end());
+        released_entities.clear();
+        if (has_given_back_blocks.load(std::memory_order_acquire)) {
+            const std::unique_lock<std::mutex> lock(get_allocators().mtx);
+            for (const auto& block: given_back_blocks) {
+                for (auto entity = block.next; entity < block.end; entity++) {
+                    free_entities.emplace_back(entity);
+                }
+            }
+            given_back_blocks.clear();
+            has_given_back_blocks.store(false, std::memory_order_relaxed);
+        }
+        free_top.store(free_entities.size(), std::memory_order_release);
+    }
+
+    [[nodiscard]] constexpr auto memory_bytes() const noexcept -> std::size_t {
+        return (free_entities.capacity() + released_entities.capacity()) * sizeof(Entity) + given_back_blocks.capacity() * sizeof(EntityBlock);
+    }
+
+private:
+    static constexpr Entity BLOCK_SIZE = 64;
+    static inline std::atomic<std::size_t> next_allocator_id = 1;
+
+    const std::size_t allocator_id;
+    std::atomic<Entity> next_block = 1;
+    std::vector<Entity> free_entities;
+    std::atomic<std::size_t> free_top = 0;
+    std::vector<Entity> released_entities;
+    std::vector<EntityBlock> given_back_blocks;
+    std::atomic<bool> has_given_back_blocks = false;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+// Requested by World::query(order_by<...>), see Registry::apply_row_orders().
+struct [[nodiscard]] RowOrder final {
+    Type order_type;
+    Type component_type;
+    void (Registry::*sort_rows)(Archetype&) noexcept;
+    bool is_conflict_reported = false;
+};
+
+class [[nodiscard]] Registry final {
+friend class World;
+friend class LateUpgrade;
+private:
+    [[nodiscard]] auto get_entity_token() noexcept -> Entity {
+        return entity_allocator.allocate();
+    }
+
+    void publish_released_entities() noexcept {
+        entity_allocator.publish();
+    }
+
+    // Upgrade only: the archetypes whose rows changed since the last upgrade get sorted again by their row order.
+    // The others are left untouched.
+    void apply_row_orders() noexcept {
+        if (row_orders.empty()) {
+            return;
+        }
+        for (const auto& archetype: archetypes) {
+            if (archetype == nullptr || !archetype->is_row_order_dirty.exchange(false, std::memory_order_relaxed)) {
+                continue;
+            }
+            if (auto row_order = find_row_order(*archetype)) {
+                (this->*row_order->sort_rows)(*archetype);
+            }
+        }
+    }
+
+    // The rows of an archetype follow one order, the first one requested on one of its components: two keys would sort
+    // each other away at every upgrade. The queries of the other orders sort their rows each time.
+    [[nodiscard]] auto find_row_order(const Archetype& archetype) noexcept -> RowOrder* {
+        RowOrder* found_row_order = nullptr;
+        for (auto& row_order: row_orders) {
+            if (!archetype.types.contains(row_order.component_type)) {
+                continue;
+            }
+            if (found_row_order == nullptr) {
+                found_row_order = &row_order;
+            } else if (!row_order.is_conflict_reported) {
+                row_order.is_conflict_reported = true;
+                ZERENGINE_DIAGNOSTIC("Registry::apply_row_orders(): Les lignes d'un archetype ne suivent qu'un seul order_by, le premier demande: les requetes des autres sont triees a chaque fois");
+            }
+        }
+        return found_row_order;
+    }
+
+    // For an id handed out by get_entity_token() but never created.
+    void release_entity_token(const Entity entity) noexcept {
+        entity_allocator.release(entity);
+    }
+
+public:
+    constexpr void create_entity(const Entity entity) noexcept {
+        if (ZERENGINE_HAS_CHECKS && is_entity_exist(entity)) {
+            ZERENGINE_DIAGNOSTIC("Registry::create_entity(): Impossible d'ajouter deux fois la meme entité: Entity[{}]", entity);
+            return;
+        }
+
+        if (entity >= entity_locations.size()) {
+            entity_locations.resize(entity + 1);
+        }
+        auto& archetype_root = *archetypes[ROOT_ARCHETYPE];
+        entity_locations[entity] = {&archetype_root, archetype_root.emplace_entity(entity)};
+        nb_entities++;
+    }
+
+    void add_components(const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept {
+        auto location = get_location(entity);
+        if (location == nullptr) {
+            ZERENGINE_DIAGNOSTIC("Registry::add_components(): Impossible d'ajouter un composant sur une entite inexistante: Entity[{}]", entity);
+            return;
+        }
+
+        if (ZERENGINE_HAS_CHECKS && location->archetype->types.contains(new_component.first)) {
+            ZERENGINE_DIAGNOSTIC("Registry::add_components(): Impossible d'ajouter deux fois le meme composant sur une entite: Entity[{}]", entity);
+            return;
+        }
+
+        auto old_archetype = location->archetype;
+        Archetype* new_archetype;
+
+        if (auto next_archetype_it = old_archetype->next_archetypes.find(new_component.first); next_archetype_it != old_archetype->next_archetypes.end()) {
+            new_archetype = archetypes[next_archetype_it->second].get();
+        } else if (!old_archetype->types.empty() && *std::prev(old_archetype->types.end()) > new_component.first) {
+            auto ordered_types = old_archetype->types;
+            ordered_types.emplace(new_component.first);
+            new_archetype = create_branch(ordered_types);
+        } else {
+            new_archetype = archetypes[emplace_archetype(old_archetype->id, new_component.first)].get();
+        }
+        move_entity(*location, new_archetype, std::move(new_component));
+
+        graph_readjustement(old_archetype);
+    }
+
+    void add_sparse_components(const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept {
+        if (!is_entity_exist(entity)) {
+            ZERENGINE_DIAGNOSTIC("Registry::add_sparse_components(): Impossible d'ajouter un composant sur une entite inexistante: Entity[{}]", entity);
+            return;
+        }
+
+        auto& sparse_set = sparse_sets[new_component.first];
+        if (ZERENGINE_HAS_CHECKS && sparse_set.contains(entity)) {
+            ZERENGINE_DIAGNOSTIC("Registry::add_sparse_components(): Impossible d'ajouter deux fois le meme composant sur une entite: Entity[{}]", entity);
+            return;
+        }
+        sparse_set.emplace(entity, std::move(new_component.second));
+    }
+
+    void remove_components(const Entity entity, const std::vector<Type>& new_types) noexcept {
+        auto location = get_location(entity);
+        if (location == nullptr) {
+            ZERENGINE_DIAGNOSTIC("Registry::remove_components(): Impossible de supprimer un composant sur une entite inexistante: Entity[{}]", entity);
+            return;
+        }
+
+        for (auto new_type: new_types) {
+            if (auto sparse_set = get_sparse_set(new_type); sparse_set != nullptr && sparse_set->contains(entity)) {
+                sparse_set->erase(entity);
+                continue;
+            }
+
+            if (ZERENGINE_HAS_CHECKS && !location->archetype->types.contains(new_type)) {
+                ZERENGINE_DIAGNOSTIC("Registry::remove_components(): Impossible de supprimer un composant inexistant sur une entite: Entity[{}]", entity);
+                return;
+            }
+
+            auto old_archetype = location->archetype;
+            Archetype* new_archetype;
+
+            if (*std::prev(old_archetype->types.end()) == new_type) {
+                new_archetype = archetypes[old_archetype->previous_archetype].get();
+            } else {
+                auto ordered_types = old_archetype->types;
+                ordered_types.erase(new_type);
+                new_archetype = create_branch(ordered_types);
+            }
+            move_entity(*location, new_archetype, {});
+
+            graph_readjustement(old_archetype);
+        }
+    }
+
+    constexpr void delete_entity(const Entity entity) noexcept {
+        if (!is_entity_exist(entity)) {
+            ZERENGINE_DIAGNOSTIC("Registry::delete_entity(): Impossible de supprimer une entite inexistante: Entity[{}]", entity);
+            return;
+        }
+
+        detach_children(entity);
+        remove_parent(entity);
+
+        for (auto& sparse_set: std::views::values(sparse_sets)) {
+            if (sparse_set.contains(entity)) {
+                sparse_set.erase(entity);
+            }
+        }
+
+        auto& location = entity_locations[entity];
+        auto old_archetype = location.archetype;
+
+        erase_row(*old_archetype, location.row);
+        location = {};
+        nb_entities--;
+        entity_allocator.release(entity);
+        graph_readjustement(old_archetype);
+    }
+
+    [[nodiscard]] constexpr auto is_entity_exist(const Entity entity) const noexcept -> bool {
+        return entity < entity_locations.size() && entity_locations[entity].archetype != nullptr;
+    }
+
+    [[nodiscard]] constexpr auto get_location(const Entity entity) noexcept -> EntityLocation* {
+        if (is_entity_exist(entity)) {
+            return &entity_locations[entity];
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] constexpr auto get_location(const Entity entity) const noexcept -> const EntityLocation* {
+        if (is_entity_exist(entity)) {
+            return &entity_locations[entity];
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] auto has_components(const Entity entity, const std::initializer_list<Type>& types) const noexcept -> bool {
+        auto location = get_location(entity);
+        if (location == nullptr) {
+            // std::cerr << "Registry::has_component(): L'entite n'existe pas/plus [" << entity << "]" << std::endl;
+            return false;
+        }
+        for (const auto& type: types) {
+            if (!location->archetype->types.contains(type)) {
+                if (auto sparse_set = get_sparse_set(type); sparse_set == nullptr || !sparse_set->contains(entity)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto get(const Entity entity, const Type type) noexcept -> std::optional<std::reference_wrapper<std::unique_ptr<IComponent>>> {
+        if (auto location = get_location(entity)) {
+            if (auto column = location->archetype->get_column(type)) {
+                return (*column)[location->row];
+            }
+            if (auto sparse_set = get_sparse_set(type); sparse_set != nullptr && sparse_set->contains(entity)) {
+                return sparse_set->components[sparse_set->sparse[entity]];
+            }
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] auto get_sparse_set(const Type type) noexcept -> SparseSet* {
+        if (auto sparse_sets_it = sparse_sets.find(type); sparse_sets_it != sparse_sets.end()) {
+            return &sparse_sets_it->second;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] auto get_sparse_set(const Type type) const noexcept -> const SparseSet* {
+        if (auto sparse_sets_it = sparse_sets.find(type); sparse_sets_it != sparse_sets.end()) {
+            return &sparse_sets_it->second;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] auto get_all_components_types(const Entity entity) const noexcept -> std::vector<Type> {
+        auto types = entity_locations.at(entity).archetype->types | std::ranges::to<std::vector<Type>>();
+        for (const auto& [type, sparse_set]: sparse_sets) {
+            if (sparse_set.contains(entity)) {
+                types.emplace_back(type);
+            }
+        }
+        return types;
+    }
+
+    [[nodiscard]] constexpr auto get_total_entities() const noexcept -> std::size_t {
+        return nb_entities;
     }
 
     [[nodiscard]] auto clear_without(const std::unordered_set<Entity>& without_entities) noexcept -> std::vector<Entity> {
         std::vector<Entity> remove_entities;
-        for (const auto entity: std::views::keys(entArch)) {
-            if (!without_entities.contains(entity)) {
+        for (Entity entity = 0; entity < entity_locations.size(); entity++) {
+            if (entity_locations[entity].archetype != nullptr && !without_entities.contains(entity)) {
                 remove_entities.emplace_back(entity);
             }
         }
@@ -575,6 +1357,68 @@ public:
         return remove_entities;
     }
 
+    void memory_stats(MemoryStats& stats) const noexcept {
+        stats.entity_location_bytes = entity_locations.capacity() * sizeof(EntityLocation) + entity_allocator.memory_bytes();
+        memory_stats_rec(stats, *archetypes[ROOT_ARCHETYPE]);
+        stats.overhead_bytes += archetypes.capacity() * sizeof(std::unique_ptr<Archetype>) + free_archetype_ids.capacity() * sizeof(ArchetypeId);
+        for (const auto& [type, sparse_set]: sparse_sets) {
+            if (auto opt_info = ComponentInfos::get(type)) {
+                stats.component_bytes += sparse_set.size() * opt_info->size;
+            }
+            stats.overhead_bytes += sparse_set.sparse.capacity() * sizeof(std::size_t) + sparse_set.entities.capacity() * sizeof(Entity) + sparse_set.components.capacity() * sizeof(std::unique_ptr<IComponent>);
+            stats.empty_slot_bytes += (sparse_set.entities.capacity() - sparse_set.size()) * sizeof(Entity) + (sparse_set.components.capacity() - sparse_set.size()) * sizeof(std::unique_ptr<IComponent>);
+        }
+        stats.overhead_bytes += hash_container_bytes(sparse_sets);
+    }
+
+private:
+    void memory_stats_rec(MemoryStats& stats, const Archetype& archetype) const noexcept {
+        const auto nb_entities = archetype.entities.size();
+        auto& archetype_stats = stats.archetypes.emplace_back(
+            std::vector<Type>(archetype.types.begin(), archetype.types.end()),
+            nb_entities,
+            0,
+            archetype.entities.capacity() * sizeof(Entity) + hash_container_bytes(archetype.future_types),
+            (archetype.entities.capacity() - nb_entities) * sizeof(Entity) + hash_container_empty_slot_bytes(archetype.future_types)
+        );
+
+        for (std::size_t i = 0; i < archetype.column_types.size(); i++) {
+            if (auto opt_info = ComponentInfos::get(archetype.column_types[i])) {
+                archetype_stats.component_bytes += nb_entities * opt_info->size;
+            }
+            archetype_stats.overhead_bytes += archetype.columns[i].capacity() * sizeof(std::unique_ptr<IComponent>);
+            archetype_stats.empty_slot_bytes += (archetype.columns[i].capacity() - nb_entities) * sizeof(std::unique_ptr<IComponent>);
+        }
+
+        if (auto column_types_it = std::ranges::find(archetype.column_types, typeid(Children).hash_code()); column_types_it != archetype.column_types.end()) {
+            for (const auto& children: archetype.columns[std::distance(archetype.column_types.begin(), column_types_it)]) {
+                stats.hierarchy_bytes += hash_container_bytes(static_cast<const Children&>(*children).children_entities);
+            }
+        }
+
+        stats.nb_entities += archetype_stats.nb_entities;
+        stats.component_bytes += archetype_stats.component_bytes;
+        stats.overhead_bytes += archetype_stats.overhead_bytes;
+        stats.empty_slot_bytes += archetype_stats.empty_slot_bytes;
+
+        for (const auto next_archetype_id: std::views::values(archetype.next_archetypes)) {
+            memory_stats_rec(stats, *archetypes[next_archetype_id]);
+        }
+    }
+
+    void move_entity(EntityLocation& location, Archetype* const new_archetype, std::pair<Type, std::unique_ptr<IComponent>>&& new_component) noexcept {
+        auto old_archetype = location.archetype;
+        const auto old_row = location.row;
+        location = {new_archetype, new_archetype->move_entity(*old_archetype, old_row, std::move(new_component))};
+        erase_row(*old_archetype, old_row);
+    }
+
+    constexpr void erase_row(Archetype& archetype, const std::size_t row) noexcept {
+        if (auto opt_moved_entity = archetype.erase_row(row)) {
+            entity_locations[opt_moved_entity.value()].row = row;
+        }
+    }
+
 public:
     template <typename ComponentType>
     void append_children_rec_down(const Entity parent_entity) noexcept {
@@ -582,7 +1426,7 @@ public:
             for (auto child_entity: opt_children.value()) {
                 if (is_entity_exist(child_entity)) {
                     if (!has_components(child_entity, {typeid(ComponentType).hash_code()})) {
-                        add_components(child_entity, {typeid(ComponentType).hash_code(), std::make_unique<ComponentType>()});
+                        add_components(child_entity, make_component<ComponentType>());
                     }
                     append_children_rec_down<ComponentType>(child_entity);
                 }
@@ -597,7 +1441,7 @@ public:
                 for (auto child_entity: opt_children.value()) {
                     if (is_entity_exist(child_entity)) {
                         if (!has_components(child_entity, {typeid(ComponentType).hash_code()})) {
-                            add_components(child_entity, {typeid(ComponentType).hash_code(), std::make_unique<ComponentType>()});
+                            add_components(child_entity, make_component<ComponentType>());
                         }
                         append_children_rec_down<ComponentType>(child_entity);
                     }
@@ -613,8 +1457,8 @@ public:
 
 public:
     void append_children(const Entity parent_entity, const std::vector<Entity>& children_entities) noexcept {
-        if (!entArch.contains(parent_entity)) {
-            std::cerr << "Registry::append_children(): Impossible d'ajouter sur une entite inexistante: Entity[" << parent_entity << "]" << std::endl;
+        if (!is_entity_exist(parent_entity)) {
+            ZERENGINE_DIAGNOSTIC("Registry::append_children(): Impossible d'ajouter sur une entite inexistante: Entity[{}]", parent_entity);
             return;
         }
 
@@ -622,16 +1466,16 @@ public:
 
         for (const auto child_entity: children_entities) {
             if (is_entity_exist(child_entity)) {
-                if (has_components(child_entity, {typeid(Parent).hash_code()})) {
-                    std::println("Children: Tu ne peux pas avoir deux parents Billy[{}]", child_entity);
-                } else if (parent_entity == child_entity) {
-                    std::println("Children: Impossible d'etre son propre pere");
+                if (ZERENGINE_HAS_CHECKS && has_components(child_entity, {typeid(Parent).hash_code()})) {
+                    ZERENGINE_DIAGNOSTIC("Children: Tu ne peux pas avoir deux parents Billy[{}]", child_entity);
+                } else if (ZERENGINE_HAS_CHECKS && parent_entity == child_entity) {
+                    ZERENGINE_DIAGNOSTIC("Children: Impossible d'etre son propre pere");
                 } else {
-                    add_components(child_entity, {typeid(Parent).hash_code(), std::make_unique<Parent>(parent_entity)});
+                    add_components(child_entity, make_component<Parent>(parent_entity));
                     new_children_entities.emplace(child_entity);
                 }
             } else {
-                std::cerr << "Registry::append_children(): Impossible d'ajouter une entite enfant qui n'existe pas: Entity[" << child_entity << "]" << std::endl;
+                ZERENGINE_DIAGNOSTIC("Registry::append_children(): Impossible d'ajouter une entite enfant qui n'existe pas: Entity[{}]", child_entity);
             }
         }
 
@@ -640,7 +1484,7 @@ public:
                 auto& children = static_cast<Children&>(*opt_children.value().get());
                 children.children_entities.insert(new_children_entities.begin(), new_children_entities.end());
             } else {
-                add_components(parent_entity, {typeid(Children).hash_code(), std::make_unique<Children>(new_children_entities)});
+                add_components(parent_entity, make_component<Children>(new_children_entities));
             }
         }
     }
@@ -684,39 +1528,546 @@ public:
         return std::nullopt;
     }
 
-private:
+    // The entity first, then its descendants.
+    [[nodiscard]] auto get_subtree(const Entity entity) noexcept -> std::vector<Entity> {
+        std::vector<Entity> subtree {entity};
+        for (std::size_t i = 0; i < subtree.size(); i++) {
+            if (auto opt_children = get_children(subtree[i])) {
+                subtree.insert(subtree.end(), opt_children.value().begin(), opt_children.value().end());
+            }
+        }
+        return subtree;
+    }
+
+    // Moves the rows of subtree (see get_subtree) into the matching archetypes of destination, without copying any component.
+    // The root is detached from its parent, the Parent/Children links inside the subtree are remapped to the new entities.
+    // The old ids are not released here: World::transfer() hands them to the next upgrade, as for a deleted entity.
+    [[nodiscard]] auto transfer(const std::vector<Entity>& subtree, Registry& destination) noexcept -> Entity {
+        remove_parent(subtree.front());
+
+        std::unordered_map<Entity, Entity> new_entities;
+        for (const auto entity: subtree) {
+            new_entities.emplace(entity, destination.get_entity_token());
+        }
+
+        for (const auto entity: subtree) {
+            const auto new_entity = new_entities.at(entity);
+            auto& location = entity_locations[entity];
+            auto old_archetype = location.archetype;
+            auto new_archetype = destination.create_branch(old_archetype->types);
+
+            const auto new_row = new_archetype->move_entity(*old_archetype, location.row, {});
+            new_archetype->entities[new_row] = new_entity;
+            if (new_entity >= destination.entity_locations.size()) {
+                destination.entity_locations.resize(new_entity + 1);
+            }
+            destination.entity_locations[new_entity] = {new_archetype, new_row};
+            destination.nb_entities++;
+
+            for (auto& [type, sparse_set]: sparse_sets) {
+                if (sparse_set.contains(entity)) {
+                    destination.sparse_sets[type].emplace(new_entity, sparse_set.extract(entity));
+                }
+            }
+
+            erase_row(*old_archetype, location.row);
+            location = {};
+            nb_entities--;
+            graph_readjustement(old_archetype);
+        }
+
+        for (const auto new_entity: std::views::values(new_entities)) {
+            if (auto opt_parent = destination.get(new_entity, typeid(Parent).hash_code())) {
+                auto& parent = static_cast<Parent&>(*opt_parent.value().get());
+                parent.parent_entity = new_entities.at(parent.parent_entity);
+            }
+            if (auto opt_children = destination.get(new_entity, typeid(Children).hash_code())) {
+                auto& children = static_cast<Children&>(*opt_children.value().get());
+                std::unordered_set<Entity> new_children_entities;
+                for (const auto child_entity: children.children_entities) {
+                    new_children_entities.emplace(new_entities.at(child_entity));
+                }
+                children.children_entities = std::move(new_children_entities);
+            }
+        }
+
+        return new_entities.at(subtree.front());
+    }
+
+    // Moves every entity into destination (commit of a streamed scene) archetype by archetype: the rows are appended to
+    // the matching archetypes without touching the components, the Parent/Children links are remapped. Returns the new entities.
+    // The old ids are not released: the staging World is destroyed after the commit.
+    [[nodiscard]] auto transfer_all(Registry& destination) noexcept -> std::vector<Entity> {
+        std::vector<Entity> new_entities(entity_locations.size());
+        std::vector<Entity> moved_entities;
+        moved_entities.reserve(nb_entities);
+        for (Entity entity = 0; entity < entity_locations.size(); entity++) {
+            if (entity_locations[entity].archetype != nullptr) {
+                new_entities[entity] = destination.get_entity_token();
+                moved_entities.emplace_back(new_entities[entity]);
+                entity_locations[entity] = {};
+            }
+        }
+        if (moved_entities.empty()) {
+            return moved_entities;
+        }
+        if (const auto max_entity = std::ranges::max(moved_entities); max_entity >= destination.entity_locations.size()) {
+            destination.entity_locations.resize(max_entity + 1);
+        }
+
+        for (const auto& archetype: archetypes) {
+            if (archetype == nullptr || archetype->entities.empty()) {
+                continue;
+            }
+            auto new_archetype = destination.create_branch(archetype->types);
+            const auto first_row = new_archetype->entities.size();
+            new_archetype->append_rows(*archetype);
+            for (auto row = first_row; row < new_archetype->entities.size(); row++) {
+                auto& entity = new_archetype->entities[row];
+                entity = new_entities[entity];
+                destination.entity_locations[entity] = {new_archetype, row};
+            }
+            if (auto column = new_archetype->get_column(typeid(Parent).hash_code())) {
+                for (auto row = first_row; row < column->size(); row++) {
+                    auto& parent = static_cast<Parent&>(*(*column)[row]);
+                    parent.parent_entity = new_entities[parent.parent_entity];
+                }
+            }
+            if (auto column = new_archetype->get_column(typeid(Children).hash_code())) {
+                for (auto row = first_row; row < column->size(); row++) {
+                    auto& children = static_cast<Children&>(*(*column)[row]);
+                    std::unordered_set<Entity> new_children_entities;
+                    for (const auto child_entity: children.children_entities) {
+                        new_children_entities.emplace(new_entities[child_entity]);
+                    }
+                    children.children_entities = std::move(new_children_entities);
+                }
+            }
+        }
+
+        for (auto& [type, sparse_set]: sparse_sets) {
+            auto& new_sparse_set = destination.sparse_sets[type];
+            for (std::size_t i = 0; i < sparse_set.entities.size(); i++) {
+                new_sparse_set.emplace(new_entities[sparse_set.entities[i]], std::move(sparse_set.components[i]));
+            }
+        }
+        sparse_sets.clear();
+
+        destination.nb_entities += nb_entities;
+        nb_entities = 0;
+        return moved_entities;
+    }
+
     template <typename... Comps>
     [[nodiscard]] constexpr auto query(const std::initializer_list<Type>& filters, const std::initializer_list<Type>& excludes) noexcept -> const Query<Comps...> {
-        std::unordered_set<std::shared_ptr<Archetype>> internal_archetypes;
+        QueryTerms terms;
+        fill_query_terms<Comps...>(terms, filters, excludes);
+
+        std::vector<ArchetypeId> internal_archetypes;
+        std::size_t nb_rows = 0;
+        visit_archetypes(terms, [&internal_archetypes, &nb_rows](const Archetype& archetype) {
+            internal_archetypes.emplace_back(archetype.id);
+            nb_rows += archetype.entities.size();
+            return true;
+        });
+        std::ranges::sort(internal_archetypes);
+
+        return Query<Comps...>(
+            archetypes,
+            std::move(internal_archetypes),
+            nb_rows,
+            {(is_sparse_component_v<query_component_t<Comps>> ? get_sparse_set(typeid(query_component_t<Comps>).hash_code()) : nullptr)...},
+            std::vector<const SparseSet*>(terms.sparse_filters.begin(), terms.sparse_filters.end()),
+            std::vector<const SparseSet*>(terms.sparse_excludes.begin(), terms.sparse_excludes.end())
+        );
+    }
 
-        std::map<Type, bool> ordered_types;
-        for (const auto type: filters) {
-            ordered_types.emplace(type, false);
+    template <typename... Comps>
+    [[nodiscard]] auto count(const std::initializer_list<Type>& filters, const std::initializer_list<Type>& excludes) noexcept -> std::size_t {
+        QueryTerms terms;
+        fill_query_terms<Comps...>(terms, filters, excludes);
+
+        std::size_t nb_rows = 0;
+        visit_archetypes(terms, [&terms, &nb_rows](const Archetype& archetype) {
+            if (terms.has_sparse_terms()) {
+                nb_rows += std::ranges::count_if(archetype.entities, [&terms](const Entity entity) {
+                    return terms.accept(entity);
+                });
+            } else {
+                nb_rows += archetype.entities.size();
+            }
+            return true;
+        });
+        return nb_rows;
+    }
+
+    // The first row found, in no particular order.
+    template <typename... Comps>
+    [[nodiscard]] auto first(const std::initializer_list<Type>& filters, const std::initializer_list<Type>& excludes) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        QueryTerms terms;
+        fill_query_terms<Comps...>(terms, filters, excludes);
+
+        std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> first_row;
+        visit_archetypes(terms, [this, &terms, &first_row](Archetype& archetype) {
+            for (std::size_t row = 0; row < archetype.entities.size(); row++) {
+                if (terms.accept(archetype.entities[row])) {
+                    first_row.emplace(get_query_row<Comps...>(archetype, row));
+                    return false;
+                }
+            }
+            return true;
+        });
+        return first_row;
+    }
+
+    // The row of the only entity matching, std::nullopt when there are none or several.
+    template <typename... Comps>
+    [[nodiscard]] auto single(const std::initializer_list<Type>& filters, const std::initializer_list<Type>& excludes) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        QueryTerms terms;
+        fill_query_terms<Comps...>(terms, filters, excludes);
+
+        std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> single_row;
+        bool is_single = true;
+        visit_archetypes(terms, [this, &terms, &single_row, &is_single](Archetype& archetype) {
+            if (!terms.has_sparse_terms() && (single_row.has_value() ? !archetype.entities.empty() : archetype.entities.size() > 1)) {
+                is_single = false;
+                return false;
+            }
+            for (std::size_t row = 0; row < archetype.entities.size(); row++) {
+                if (terms.accept(archetype.entities[row])) {
+                    if (single_row.has_value()) {
+                        is_single = false;
+                        return false;
+                    }
+                    single_row.emplace(get_query_row<Comps...>(archetype, row));
+                }
+            }
+            return true;
+        });
+        if (!is_single) {
+            return std::nullopt;
         }
-        for (const auto type: excludes) {
-            ordered_types.insert_or_assign(type, true);
+        return single_row;
+    }
+
+    // Children without a parent, or whose parent lacks one of ParentComps, are not part of the join.
+    // Rows are grouped by parent archetype inside each archetype of the children.
+    template <typename... ParentComps, typename... Comps>
+    [[nodiscard]] auto join_parents(const Query<Comps...>& children) noexcept -> MaterializedQuery<typename QueryTerm<Comps>::reference..., ParentComps&...> {
+        using Join = MaterializedQuery<typename QueryTerm<Comps>::reference..., ParentComps&...>;
+        using ParentColumns = std::array<std::vector<std::unique_ptr<IComponent>>*, sizeof...(ParentComps)>;
+
+        std::vector<typename Join::value_type> joined_rows;
+        // Grouped by child archetype then by parent archetype id: the arena index does not depend on allocation addresses.
+        std::vector<std::pair<std::size_t, ArchetypeId>> groups;
+        std::unordered_map<const Archetype*, ParentColumns> parent_columns_cache;
+
+        const Archetype* child_archetype = nullptr;
+        std::vector<std::unique_ptr<IComponent>>* parent_entity_column = nullptr;
+        std::size_t nb_child_archetypes = 0;
+        for (const auto& child_row: children) {
+            const auto& child_location = entity_locations[std::get<0>(child_row)];
+            if (child_location.archetype != child_archetype) {
+                child_archetype = child_location.archetype;
+                parent_entity_column = child_location.archetype->get_column(typeid(Parent).hash_code());
+                nb_child_archetypes++;
+            }
+
+            const auto parent_location = get_location(static_cast<const Parent&>(*(*parent_entity_column)[child_location.row]).parent_entity);
+            if (parent_location == nullptr) {
+                continue;
+            }
+
+            auto parent_columns_it = parent_columns_cache.find(parent_location->archetype);
+            if (parent_columns_it == parent_columns_cache.end()) {
+                parent_columns_it = parent_columns_cache.emplace(parent_location->archetype, ParentColumns {(is_sparse_component_v<ParentComps> ? nullptr : parent_location->archetype->get_column(typeid(ParentComps).hash_code()))...}).first;
+            }
+
+            const auto parent_entity = parent_location->archetype->entities[parent_location->row];
+            const auto parent_components = [&]<std::size_t... Is>(std::index_sequence<Is...>) -> std::tuple<ParentComps*...> {
+                return {get_join_component<ParentComps>(parent_entity, parent_columns_it->second[Is], parent_location->row)...};
+            }(std::index_sequence_for<ParentComps...>());
+            if (std::apply([](const auto*... parent_component) { return ((parent_component == nullptr) || ...); }, parent_components)) {
+                continue;
+            }
+
+            joined_rows.emplace_back(std::tuple_cat(child_row, std::apply([](auto*... parent_component) { return std::tuple<ParentComps&...>(*parent_component...); }, parent_components)));
+            groups.emplace_back(nb_child_archetypes, parent_location->archetype->id);
+        }
+
+        std::vector<std::size_t> order(joined_rows.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&groups](const std::size_t a, const std::size_t b) {
+            return groups[a] < groups[b];
+        });
+
+        std::vector<typename Join::value_type> rows;
+        rows.reserve(order.size());
+        for (const auto index: order) {
+            rows.emplace_back(joined_rows[index]);
+        }
+        return Join(std::move(rows));
+    }
+
+    // Runs of rows from one archetype are already sorted by the last upgrade unless their keys changed since:
+    // only those runs are sorted again, and their archetype is sorted by the next upgrade, then the runs are merged.
+    // The scratch vectors are kept per thread, the queries run on the workers.
+    template <auto Key, typename... Comps>
+    [[nodiscard]] auto order_rows(const Query<Comps...>& query) noexcept -> MaterializedQuery<typename QueryTerm<Comps>::reference...> {
+        using Component = order_component_t<Key>;
+        using Rows = MaterializedQuery<typename QueryTerm<Comps>::reference...>;
+
+        const auto order_type = typeid(OrderBy<Key>).hash_code();
+        {
+            std::scoped_lock lock(row_orders_mutex);
+            if (std::ranges::find(row_orders, order_type, &RowOrder::order_type) == row_orders.end()) {
+                row_orders.emplace_back(order_type, typeid(Component).hash_code(), &Registry::sort_rows<Key>);
+            }
+        }
+
+        static thread_local std::vector<typename Rows::value_type> unordered_rows;
+        static thread_local std::vector<order_key_t<Key>> keys;
+        static thread_local std::vector<std::size_t> run_begins;
+        static thread_local std::vector<Archetype*> run_archetypes;
+        static thread_local std::vector<std::size_t> merged_run_begins;
+        static thread_local std::vector<std::size_t> order;
+        unordered_rows.clear();
+        keys.clear();
+        run_begins.clear();
+        run_archetypes.clear();
+
+        Archetype* archetype = nullptr;
+        std::vector<std::unique_ptr<IComponent>>* key_column = nullptr;
+        for (const auto& row: query) {
+            const auto& location = entity_locations[std::get<0>(row)];
+            if (location.archetype != archetype) {
+                archetype = location.archetype;
+                key_column = location.archetype->get_column(typeid(Component).hash_code());
+                run_begins.emplace_back(unordered_rows.size());
+                run_archetypes.emplace_back(archetype);
+            }
+            keys.emplace_back(std::invoke(Key, static_cast<const Component&>(*(*key_column)[location.row])));
+            unordered_rows.emplace_back(row);
+        }
+        run_begins.emplace_back(unordered_rows.size());
+
+        const auto compare_keys = [](const std::size_t a, const std::size_t b) {
+            return keys[a] < keys[b];
+        };
+
+        order.resize(unordered_rows.size());
+        std::iota(order.begin(), order.end(), 0);
+        for (std::size_t run = 0; run + 1 < run_begins.size(); run++) {
+            if (!std::is_sorted(keys.begin() + run_begins[run], keys.begin() + run_begins[run + 1])) {
+                std::stable_sort(order.begin() + run_begins[run], order.begin() + run_begins[run + 1], compare_keys);
+                if (is_row_order_of(*run_archetypes[run], order_type)) {
+                    run_archetypes[run]->is_row_order_lost.store(true, std::memory_order_relaxed);
+                    run_archetypes[run]->is_row_order_dirty.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        while (run_begins.size() > 2) {
+            merged_run_begins.clear();
+            for (std::size_t run = 0; run + 1 < run_begins.size(); run += 2) {
+                merged_run_begins.emplace_back(run_begins[run]);
+                if (run + 2 < run_begins.size()) {
+                    std::inplace_merge(order.begin() + run_begins[run], order.begin() + run_begins[run + 1], order.begin() + run_begins[run + 2], compare_keys);
+                }
+            }
+            merged_run_begins.emplace_back(run_begins.back());
+            run_begins.swap(merged_run_begins);
+        }
+
+        std::vector<typename Rows::value_type> rows;
+        rows.reserve(order.size());
+        for (const auto index: order) {
+            rows.emplace_back(unordered_rows[index]);
+        }
+        return Rows(std::move(rows));
+    }
+
+    // Whether the rows of archetype follow this order, see find_row_order(). From the queries: takes row_orders_mutex.
+    [[nodiscard]] auto is_row_order_of(const Archetype& archetype, const Type order_type) noexcept -> bool {
+        std::scoped_lock lock(row_orders_mutex);
+        for (const auto& row_order: row_orders) {
+            if (archetype.types.contains(row_order.component_type)) {
+                return row_order.order_type == order_type;
+            }
+        }
+        return false;
+    }
+
+    // Only the rows added or moved since the last sort are sorted, then each one is inserted by binary search among the rows
+    // still in order. The rows are permuted from the first one out of place. The keys are kept per thread: several Worlds
+    // may upgrade at the same time.
+    template <auto Key>
+    void sort_rows(Archetype& archetype) noexcept {
+        using Component = order_component_t<Key>;
+        const auto& key_column = *archetype.get_column(typeid(Component).hash_code());
+        const auto get_key = [&key_column](const std::size_t row) {
+            return std::invoke(Key, static_cast<const Component&>(*key_column[row]));
+        };
+        const auto nb_rows = archetype.entities.size();
+
+        if (archetype.is_row_order_lost.exchange(false, std::memory_order_relaxed)) {
+            archetype.nb_ordered_rows = 0;
+            archetype.moved_rows.clear();
+        }
+        auto& moved_rows = archetype.moved_rows;
+        std::erase_if(moved_rows, [&archetype](const std::size_t row) {
+            return row >= archetype.nb_ordered_rows;
+        });
+        std::ranges::sort(moved_rows);
+        moved_rows.erase(std::ranges::unique(moved_rows).begin(), moved_rows.end());
+
+        static thread_local std::vector<std::pair<order_key_t<Key>, std::size_t>> new_rows;
+        new_rows.clear();
+        sort_scratch_rows.clear();
+        auto moved_rows_it = moved_rows.begin();
+        for (std::size_t row = 0; row < archetype.nb_ordered_rows; row++) {
+            if (moved_rows_it != moved_rows.end() && *moved_rows_it == row) {
+                new_rows.emplace_back(get_key(row), row);
+                moved_rows_it++;
+            } else {
+                sort_scratch_rows.emplace_back(row);
+            }
+        }
+        for (std::size_t row = archetype.nb_ordered_rows; row < nb_rows; row++) {
+            new_rows.emplace_back(get_key(row), row);
+        }
+        archetype.nb_ordered_rows = nb_rows;
+        moved_rows.clear();
+        if (new_rows.empty()) {
+            return;
+        }
+
+        std::ranges::stable_sort(new_rows, {}, &std::pair<order_key_t<Key>, std::size_t>::first);
+        sort_scratch_order.clear();
+        auto ordered_rows_it = sort_scratch_rows.begin();
+        for (const auto& [new_key, new_row]: new_rows) {
+            const auto insert_it = std::upper_bound(ordered_rows_it, sort_scratch_rows.end(), new_key, [&get_key](const auto& key, const std::size_t row) {
+                return key < get_key(row);
+            });
+            sort_scratch_order.insert(sort_scratch_order.end(), ordered_rows_it, insert_it);
+            sort_scratch_order.emplace_back(new_row);
+            ordered_rows_it = insert_it;
+        }
+        sort_scratch_order.insert(sort_scratch_order.end(), ordered_rows_it, sort_scratch_rows.end());
+
+        std::size_t first_row = 0;
+        while (first_row < nb_rows && sort_scratch_order[first_row] == first_row) {
+            first_row++;
+        }
+        if (first_row == nb_rows) {
+            return;
+        }
+        archetype.permute_rows(sort_scratch_order, first_row, sort_scratch_entities, sort_scratch_column);
+        for (std::size_t row = first_row; row < nb_rows; row++) {
+            entity_locations[archetype.entities[row]].row = row;
         }
+    }
 
-        if (filters.size() == 0) {
-            if (!archetype_root->entity_components.empty()) {
-                internal_archetypes.emplace(archetype_root);
+    template <typename T>
+    [[nodiscard]] auto get_join_component(const Entity entity, std::vector<std::unique_ptr<IComponent>>* column, const std::size_t row) noexcept -> T* {
+        if constexpr (is_sparse_component_v<T>) {
+            auto sparse_set = get_sparse_set(typeid(T).hash_code());
+            if (sparse_set == nullptr || !sparse_set->contains(entity)) {
+                return nullptr;
             }
+            return static_cast<T*>(sparse_set->get(entity));
+        } else {
+            return column ? static_cast<T*>((*column)[row].get()) : nullptr;
         }
+    }
 
-        query_rec(ordered_types, filters.size(), 1, ordered_types.begin(), archetype_root, 0, internal_archetypes);
+    template <typename... Comps>
+    [[nodiscard]] auto get_query_row(Archetype& archetype, const std::size_t row) noexcept -> std::tuple<const Entity, typename QueryTerm<Comps>::reference...> {
+        const auto entity = archetype.entities[row];
+        return {entity, get_query_component<Comps>(archetype, entity, row)...};
+    }
 
-        return Query<Comps...>(internal_archetypes);
+    template <typename T>
+    [[nodiscard]] auto get_query_component(Archetype& archetype, const Entity entity, const std::size_t row) noexcept -> typename QueryTerm<T>::reference {
+        using Component = query_component_t<T>;
+        const auto component = get_join_component<Component>(entity, is_sparse_component_v<Component> ? nullptr : archetype.get_column(typeid(Component).hash_code()), row);
+        if constexpr (QueryTerm<T>::is_optional) {
+            return component;
+        } else {
+            return *component;
+        }
     }
 
 private:
-    void query_rec(const std::map<Type, bool>& ordered_types, const std::size_t nb_types, const std::size_t current_nb_types, std::map<Type, bool>::iterator current_type_it, const std::shared_ptr<Archetype>& current_archetype, const Type filter, std::unordered_set<std::shared_ptr<Archetype>>& internal_archetypes) const noexcept {
-        if (current_type_it != ordered_types.end() && !current_type_it->second) {
-            if (!current_archetype->future_types.contains(current_type_it->first)) {
+    // The archetype terms sorted by type (true for an exclusion) and the sparse terms, checked per row.
+    // Allocated in their own buffer: matching the archetypes does not touch the heap.
+    struct [[nodiscard]] QueryTerms final {
+        QueryTerms() noexcept = default;
+        QueryTerms(const QueryTerms&) = delete;
+        auto operator=(const QueryTerms&) -> QueryTerms& = delete;
+
+        [[nodiscard]] auto has_sparse_terms() const noexcept -> bool {
+            return !sparse_filters.empty() || !sparse_excludes.empty();
+        }
+
+        [[nodiscard]] auto accept(const Entity entity) const noexcept -> bool {
+            return std::ranges::all_of(sparse_filters, [entity](const SparseSet* sparse_set) { return sparse_set->contains(entity); })
+                && std::ranges::none_of(sparse_excludes, [entity](const SparseSet* sparse_set) { return sparse_set->contains(entity); });
+        }
+
+        std::array<std::byte, 1024> buffer;
+        std::pmr::monotonic_buffer_resource resource {buffer.data(), buffer.size()};
+        std::pmr::map<Type, bool> ordered_types {&resource};
+        std::size_t nb_filters = 0;
+        std::pmr::vector<const SparseSet*> sparse_filters {&resource};
+        std::pmr::vector<const SparseSet*> sparse_excludes {&resource};
+    };
+
+    // A sparse type that was never added has no sparse set: it is then handled as an archetype type no archetype contains.
+    template <typename... Comps>
+    void fill_query_terms(QueryTerms& terms, const std::initializer_list<Type>& filters, const std::initializer_list<Type>& excludes) const noexcept {
+        for (const auto type: filters) {
+            // Opt<T> terms do not restrict the archetypes.
+            if (((QueryTerm<Comps>::is_optional && type == typeid(Comps).hash_code()) || ...)) {
+                continue;
+            }
+            if (auto sparse_set = get_sparse_set(type)) {
+                terms.sparse_filters.emplace_back(sparse_set);
+            } else if (terms.ordered_types.emplace(type, false).second) {
+                terms.nb_filters++;
+            }
+        }
+        for (const auto type: excludes) {
+            if (auto sparse_set = get_sparse_set(type)) {
+                terms.sparse_excludes.emplace_back(sparse_set);
+            } else {
+                terms.ordered_types.insert_or_assign(type, true);
+            }
+        }
+    }
+
+    // Calls visit on every non empty archetype matching the archetype terms, until it returns false.
+    // The archetype graph is a tree in type order: each archetype is visited once.
+    template <typename Visitor>
+    void visit_archetypes(QueryTerms& terms, Visitor&& visit) const noexcept {
+        if (terms.nb_filters == 0 && !archetypes[ROOT_ARCHETYPE]->entities.empty()) {
+            if (!visit(*archetypes[ROOT_ARCHETYPE])) {
                 return;
             }
         }
+        query_rec(terms.ordered_types, terms.nb_filters, 1, terms.ordered_types.begin(), *archetypes[ROOT_ARCHETYPE], 0, visit);
+    }
+
+    template <typename Visitor>
+    auto query_rec(const std::pmr::map<Type, bool>& ordered_types, const std::size_t nb_types, const std::size_t current_nb_types, std::pmr::map<Type, bool>::iterator current_type_it, const Archetype& current_archetype, const Type filter, Visitor& visit) const noexcept -> bool {
+        if (current_type_it != ordered_types.end() && !current_type_it->second) {
+            if (!current_archetype.future_types.contains(current_type_it->first)) {
+                return true;
+            }
+        }
 
-        for (const auto& [next_type, next_archetype]: current_archetype->next_archetypes) {
+        for (const auto& [next_type, next_archetype_id]: current_archetype.next_archetypes) {
+            auto& next_archetype = *archetypes[next_archetype_id];
             if (next_type < filter) {
                 continue;
             }
@@ -726,23 +2077,35 @@ private:
                     if (next_type > current_type_it->first) {
                         break;
                     } else if (next_type < current_type_it->first) {
-                        query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, internal_archetypes);
+                        if (!query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, visit)) {
+                            return false;
+                        }
                         continue;
                     } else {
-                        if (current_nb_types >= nb_types && !next_archetype->entity_components.empty()) {
-                            internal_archetypes.emplace(next_archetype);
+                        if (current_nb_types >= nb_types && !next_archetype.entities.empty()) {
+                            if (!visit(next_archetype)) {
+                                return false;
+                            }
+                        }
+                        if (!query_rec(ordered_types, nb_types, current_nb_types + 1, std::next(current_type_it), next_archetype, 0, visit)) {
+                            return false;
                         }
-                        query_rec(ordered_types, nb_types, current_nb_types + 1, std::next(current_type_it), next_archetype, 0, internal_archetypes);
                     }
                 } else {
                     if (next_type < current_type_it->first) {
-                        if (current_nb_types > nb_types && !next_archetype->entity_components.empty()) {
-                            internal_archetypes.emplace(next_archetype);
+                        if (current_nb_types > nb_types && !next_archetype.entities.empty()) {
+                            if (!visit(next_archetype)) {
+                                return false;
+                            }
+                        }
+                        if (!query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, visit)) {
+                            return false;
                         }
-                        query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, internal_archetypes);
                         continue;
                     } else if (next_type > current_type_it->first) {
-                        query_rec(ordered_types, nb_types, current_nb_types, std::next(current_type_it), current_archetype, current_type_it->first, internal_archetypes);
+                        if (!query_rec(ordered_types, nb_types, current_nb_types, std::next(current_type_it), current_archetype, current_type_it->first, visit)) {
+                            return false;
+                        }
                         break;
                     } else {
                         current_type_it++;
@@ -750,49 +2113,87 @@ private:
                     }
                 }
             } else {
-                if (current_nb_types >= nb_types && !next_archetype->entity_components.empty()) {
-                    internal_archetypes.emplace(next_archetype);
+                if (current_nb_types >= nb_types && !next_archetype.entities.empty()) {
+                    if (!visit(next_archetype)) {
+                        return false;
+                    }
+                }
+                if (!query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, visit)) {
+                    return false;
                 }
-                query_rec(ordered_types, nb_types, current_nb_types, current_type_it, next_archetype, 0, internal_archetypes);
             }
         }
+        return true;
     }
 
 private:
-    void create_branch(const std::set<Type>& ordered_types, const Entity entity) noexcept {
-        auto current_archetype = archetype_root;
+    [[nodiscard]] auto create_branch(const std::set<Type>& ordered_types) noexcept -> Archetype* {
+        auto current_archetype = ROOT_ARCHETYPE;
         for (auto ordered_types_it = ordered_types.begin(); ordered_types_it != ordered_types.end(); ordered_types_it++) {
-            if (auto next_archetypes_it = current_archetype->next_archetypes.find(*ordered_types_it); next_archetypes_it != current_archetype->next_archetypes.end()) {
+            const auto& next_archetypes = archetypes[current_archetype]->next_archetypes;
+            if (auto next_archetypes_it = next_archetypes.find(*ordered_types_it); next_archetypes_it != next_archetypes.end()) {
                 current_archetype = next_archetypes_it->second;
             } else {
                 for (; ordered_types_it != ordered_types.end(); ordered_types_it++) {
-                    current_archetype = current_archetype->next_archetypes.emplace(
-                        *ordered_types_it,
-                        std::make_shared<Archetype>(current_archetype, *ordered_types_it)
-                    ).first->second;
+                    current_archetype = emplace_archetype(current_archetype, *ordered_types_it);
                 }
                 break;
             }
         }
-        entArch.at(entity) = current_archetype;
+        return archetypes[current_archetype].get();
     }
 
-    void graph_readjustement(const std::shared_ptr<Archetype>& old_archetype) noexcept {
+    // Slots of pruned archetypes are reused, the Archetype objects never move: EntityLocation keeps plain pointers.
+    [[nodiscard]] auto emplace_archetype(const ArchetypeId old_archetype_id, const Type new_type) noexcept -> ArchetypeId {
+        ArchetypeId new_archetype_id;
+        if (free_archetype_ids.empty()) {
+            new_archetype_id = static_cast<ArchetypeId>(archetypes.size());
+            archetypes.emplace_back();
+        } else {
+            new_archetype_id = free_archetype_ids.back();
+            free_archetype_ids.pop_back();
+        }
+        archetypes[new_archetype_id] = std::make_unique<Archetype>(*archetypes[old_archetype_id], old_archetype_id, new_type);
+        archetypes[new_archetype_id]->id = new_archetype_id;
+        archetypes[old_archetype_id]->next_archetypes.emplace(new_type, new_archetype_id);
+
+        for (auto previous_archetype_id = old_archetype_id; previous_archetype_id != NO_ARCHETYPE; previous_archetype_id = archetypes[previous_archetype_id]->previous_archetype) {
+            archetypes[previous_archetype_id]->future_types.emplace(new_type);
+        }
+        return new_archetype_id;
+    }
+
+    void graph_readjustement(Archetype* const old_archetype) noexcept {
         auto remove_old_rec = old_archetype;
-        while (!remove_old_rec->previous_archetype.expired() && remove_old_rec->entity_components.empty() && remove_old_rec->next_archetypes.empty()) {
-            auto old_previous_archetype = remove_old_rec->previous_archetype.lock();
-            old_previous_archetype->next_archetypes.erase(
+        while (remove_old_rec->previous_archetype != NO_ARCHETYPE && remove_old_rec->entities.empty() && remove_old_rec->next_archetypes.empty()) {
+            const auto old_previous_archetype_id = remove_old_rec->previous_archetype;
+            archetypes[old_previous_archetype_id]->next_archetypes.erase(
                 *std::prev(remove_old_rec->types.end())
             );
-            remove_old_rec = old_previous_archetype;
+            free_archetype_ids.emplace_back(remove_old_rec->id);
+            archetypes[remove_old_rec->id].reset();
+            remove_old_rec = archetypes[old_previous_archetype_id].get();
         }
     }
 
 private:
-    Entity last_entity_token = 1;
-    std::vector<Entity> entity_tokens;
-    std::unordered_map<Entity, std::shared_ptr<Archetype>> entArch;
-    std::shared_ptr<Archetype> archetype_root = std::make_shared<Archetype>();
+    EntityAllocator entity_allocator;
+    std::vector<EntityLocation> entity_locations;
+    std::size_t nb_entities = 0;
+    std::unordered_map<Type, SparseSet> sparse_sets;
+    std::vector<std::unique_ptr<Archetype>> archetypes = [] {
+        std::vector<std::unique_ptr<Archetype>> new_archetypes;
+        new_archetypes.emplace_back(std::make_unique<Archetype>());
+        return new_archetypes;
+    }();
+    std::vector<ArchetypeId> free_archetype_ids;
+    // In request order, see find_row_order().
+    std::vector<RowOrder> row_orders;
+    std::mutex row_orders_mutex;
+    std::vector<std::size_t> sort_scratch_rows;
+    std::vector<std::size_t> sort_scratch_order;
+    std::vector<Entity> sort_scratch_entities;
+    std::vector<std::unique_ptr<IComponent>> sort_scratch_column;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -805,6 +2206,10 @@ static void registry_message_callback_add_components(Registry& registry, const E
     registry.add_components(entity, std::move(components));
 }
 
+static void registry_message_callback_add_sparse_components(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& components, const std::vector<Type>&, const std::vector<Entity>&) {
+    registry.add_sparse_components(entity, std::move(components));
+}
+
 static void registry_message_callback_remove_components(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>& new_types, const std::vector<Entity>&) {
     registry.remove_components(entity, new_types);
 }
@@ -818,7 +2223,7 @@ static void registry_message_callback_append_children(Registry& registry, const
 static void setInactiveRec(Registry& registry, const Entity entity) {
     if (registry.is_entity_exist(entity)) {
         if (!registry.has_components(entity, {typeid(IsInactive).hash_code()})) {
-            registry.add_components(entity, {typeid(IsInactive).hash_code(), std::make_unique<IsInactive>()});
+            registry.add_components(entity, make_component<IsInactive>());
             if (auto opt_children = registry.get_children(entity)) {
                 for (auto childEnt: opt_children.value()) {
                     setInactiveRec(registry, childEnt);
@@ -842,64 +2247,455 @@ static void setActiveRec(Registry& registry, const Entity entity) {
                 }
             }
         }
-    }
-}
+    }
+}
+
+static void registry_message_callback_set_active(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
+    setActiveRec(registry, entity);
+}
+
+static void addDontDestroyOnLoadRec(Registry& registry, const Entity entity) {
+    if (registry.is_entity_exist(entity)) {
+        if (!registry.has_components(entity, {typeid(DontDestroyOnLoad).hash_code()})) {
+            registry.add_components(entity, make_component<DontDestroyOnLoad>());
+            if (auto opt_children = registry.get_children(entity)) {
+                for (auto child_entity: opt_children.value()) {
+                    addDontDestroyOnLoadRec(registry, child_entity);
+                }
+            }
+        }
+    }
+}
+
+static void registry_message_callback_add_font_destroy_on_load(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
+    addDontDestroyOnLoadRec(registry, entity);
+}
+
+static void destroyChildRec(Registry& registry, const Entity parent_entity) noexcept {
+    if (registry.is_entity_exist(parent_entity)) {
+        if (auto childrenOpt = registry.get_children(parent_entity)) {
+            for (const auto childEnt: childrenOpt.value()) {
+                destroyChildRec(registry, childEnt);
+            }
+        }
+        registry.delete_entity(parent_entity);
+    }
+}
+
+static void registry_message_callback_delete_entity(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
+    destroyChildRec(registry, entity);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+inline std::atomic<std::size_t> next_thread_buffers_id = 1;
+
+// Multi-producer buffers without lock: each thread appends to its own buffer, registered once with a lock-free push.
+// drain() is called by a single thread while no thread appends (after the threaded systems, or between two frames).
+// With IsLocked, drain() may run while threads append: each buffer takes its own lock, only contended by drain().
+template <typename T, bool IsLocked = false>
+class [[nodiscard]] ThreadBuffers final {
+private:
+    struct WriterBuffer;
+
+    // The buffers of one thread, by ThreadBuffers id. Kept alive by its WriterBuffers if the thread exits first,
+    // so that ~ThreadBuffers() can erase its entries.
+    struct [[nodiscard]] ThreadWriters final {
+        std::mutex mtx;
+        std::unordered_map<std::size_t, WriterBuffer*> writers;
+    };
+
+    // One per thread that ever appended, never freed before the ThreadBuffers.
+    struct [[nodiscard]] WriterBuffer final {
+        std::vector<T> values;
+        WriterBuffer* next = nullptr;
+        std::mutex mtx;
+        std::shared_ptr<ThreadWriters> thread_writers;
+    };
+
+public:
+    ThreadBuffers() noexcept:
+        buffers_id(next_thread_buffers_id.fetch_add(1, std::memory_order_relaxed)) {
+    }
+
+    ThreadBuffers(ThreadBuffers&& oth) noexcept:
+        buffers_id(oth.buffers_id),
+        writers(oth.writers.exchange(nullptr, std::memory_order_acq_rel)) {
+        oth.buffers_id = next_thread_buffers_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ThreadBuffers(const ThreadBuffers&) = delete;
+    auto operator=(const ThreadBuffers&) -> ThreadBuffers& = delete;
+    auto operator=(ThreadBuffers&&) -> ThreadBuffers& = delete;
+
+    ~ThreadBuffers() noexcept {
+        for (auto writer = writers.load(std::memory_order_acquire); writer != nullptr;) {
+            {
+                const std::unique_lock<std::mutex> lock(writer->thread_writers->mtx);
+                writer->thread_writers->writers.erase(buffers_id);
+            }
+            delete std::exchange(writer, writer->next);
+        }
+    }
+
+public:
+    template <typename... Args>
+    void emplace_back(Args&&... args) noexcept {
+        auto& writer = get_writer();
+        if constexpr (IsLocked) {
+            const std::unique_lock<std::mutex> lock(writer.mtx);
+            writer.values.emplace_back(std::forward<Args>(args)...);
+        } else {
+            writer.values.emplace_back(std::forward<Args>(args)...);
+        }
+    }
+
+    // Moves the values of every thread at the end of values, grouped by thread.
+    void drain(std::vector<T>& values) noexcept {
+        for (auto writer = writers.load(std::memory_order_acquire); writer != nullptr; writer = writer->next) {
+            std::unique_lock<std::mutex> lock(writer->mtx, std::defer_lock);
+            if constexpr (IsLocked) {
+                lock.lock();
+            }
+            std::ranges::move(writer->values, std::back_inserter(values));
+            writer->values.clear();
+        }
+    }
+
+private:
+    [[nodiscard]] auto get_writer() noexcept -> WriterBuffer& {
+        if (last_writer.first == buffers_id) {
+            return *last_writer.second;
+        }
+
+        const std::unique_lock<std::mutex> lock(thread_writers->mtx);
+        auto& writer = thread_writers->writers[buffers_id];
+        if (writer == nullptr) {
+            writer = new WriterBuffer();
+            writer->thread_writers = thread_writers;
+            writer->next = writers.load(std::memory_order_relaxed);
+            while (!writers.compare_exchange_weak(writer->next, writer, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+        last_writer = {buffers_id, writer};
+        return *writer;
+    }
+
+private:
+    // Ids are never reused: last_writer is never matched again once its ThreadBuffers is destroyed.
+    static inline thread_local std::pair<std::size_t, WriterBuffer*> last_writer {0, nullptr};
+    static inline thread_local std::shared_ptr<ThreadWriters> thread_writers = std::make_shared<ThreadWriters>();
+
+    std::size_t buffers_id;
+    std::atomic<WriterBuffer*> writers {nullptr};
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+class [[nodiscard]] Profiler final {
+friend class ProfilerScope;
+friend class World;
+friend class ZerEngine;
+private:
+    struct [[nodiscard]] ProfilerEvent final {
+        const char* name;
+        const void* address;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        std::thread::id thread_id;
+    };
+
+private:
+    Profiler() = default;
+
+public:
+    template <typename R, typename... Args>
+    [[nodiscard]] static auto system_address(R(*const function)(Args...)) noexcept -> const void* {
+        return reinterpret_cast<const void*>(function);
+    }
+
+    template <typename R, typename... Args>
+    [[nodiscard]] static auto system_address(const std::function<R(Args...)>& function) noexcept -> const void* {
+        if (auto target = function.template target<R(*)(Args...)>()) {
+            return reinterpret_cast<const void*>(*target);
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] auto is_capturing() const noexcept -> bool {
+        return capturing.load(std::memory_order_relaxed);
+    }
+
+private:
+    void capture([[maybe_unused]] const std::size_t new_nb_frames, [[maybe_unused]] const std::string& new_path) noexcept {
+        #ifdef ZERENGINE_PROFILER
+            const std::unique_lock<std::mutex> lock(mtx);
+            if (new_nb_frames == 0) {
+                return;
+            }
+            if (capturing.load(std::memory_order_relaxed)) {
+                ZERENGINE_DIAGNOSTIC("ZerEngine::Profiler::capture() - Une capture est deja en cours: {}", path);
+                return;
+            }
+            // Scopes that ended after the previous capture stopped.
+            thread_events.drain(events);
+            events.clear();
+            nb_frames_left = new_nb_frames;
+            path = new_path;
+            origin = std::chrono::steady_clock::now();
+            capturing.store(true, std::memory_order_relaxed);
+        #else
+            ZERENGINE_DIAGNOSTIC("ZerEngine::Profiler::capture() - Le profiler est desactive, compilez avec ZERENGINE_PROFILER: {} frames, {}", new_nb_frames, new_path);
+        #endif
+    }
+
+    // From any thread, without lock: the events are merged by end_frame().
+    void record(const char* const name, const void* const address, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end) noexcept {
+        if (capturing.load(std::memory_order_relaxed)) {
+            thread_events.emplace_back(name, address, start, end, std::this_thread::get_id());
+        }
+    }
+
+    // After the last upgrade of the frame. The file is written once the lock is released.
+    void end_frame() noexcept {
+        if (!capturing.load(std::memory_order_relaxed)) {
+            return;
+        }
+        std::vector<ProfilerEvent> captured_events;
+        std::string captured_path;
+        std::chrono::steady_clock::time_point captured_origin;
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            thread_events.drain(events);
+            if (--nb_frames_left != 0) {
+                return;
+            }
+            capturing.store(false, std::memory_order_relaxed);
+            captured_events.swap(events);
+            captured_path = path;
+            captured_origin = origin;
+        }
+        dump(captured_events, captured_path, captured_origin);
+    }
+
+    // Chrome trace event format (chrome://tracing, ui.perfetto.dev): complete events ("ph":"X") in microseconds.
+    static void dump(const std::vector<ProfilerEvent>& events, const std::string& path, const std::chrono::steady_clock::time_point origin) noexcept {
+        std::ofstream file(path);
+        if (!file) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::Profiler::dump() - Impossible d'ouvrir le fichier: {}", path);
+            return;
+        }
+
+        std::vector<std::thread::id> thread_ids;
+        file << "{\"traceEvents\":[";
+        for (std::size_t i = 0; i < events.size(); i++) {
+            const auto& event = events[i];
+            auto thread_ids_it = std::find(thread_ids.begin(), thread_ids.end(), event.thread_id);
+            if (thread_ids_it == thread_ids.end()) {
+                thread_ids_it = thread_ids.insert(thread_ids.end(), event.thread_id);
+            }
+            file << (i == 0 ? "" : ",") << "\n{\"name\":\"" << event.name;
+            if (event.address != nullptr) {
+                file << " " << event.address;
+            }
+            file << "\",\"cat\":\"zerengine\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << std::distance(thread_ids.begin(), thread_ids_it)
+                << ",\"ts\":" << std::chrono::duration<double, std::micro>(event.start - origin).count()
+                << ",\"dur\":" << std::chrono::duration<double, std::micro>(event.end - event.start).count()
+                << "}";
+        }
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+private:
+    std::atomic<bool> capturing {false};
+    std::mutex mtx;
+    // Locked: the coroutines resumed by the workers may end a scope while end_frame() merges.
+    ThreadBuffers<ProfilerEvent, true> thread_events;
+    std::vector<ProfilerEvent> events;
+    std::size_t nb_frames_left {0};
+    std::string path;
+    std::chrono::steady_clock::time_point origin;
+};
+
+class [[nodiscard]] ProfilerScope final {
+public:
+    ProfilerScope(Profiler& new_profiler, const char* const new_name, const void* const new_address = nullptr) noexcept:
+        profiler(new_profiler.is_capturing() ? &new_profiler : nullptr),
+        name(new_name),
+        address(new_address) {
+        if (profiler != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ProfilerScope(const ProfilerScope&) = delete;
+    auto operator=(const ProfilerScope&) -> ProfilerScope& = delete;
+
+    ~ProfilerScope() noexcept {
+        if (profiler != nullptr) {
+            profiler->record(name, address, start, std::chrono::steady_clock::now());
+        }
+    }
+
+private:
+    Profiler* const profiler;
+    const char* const name;
+    const void* const address;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Without ZERENGINE_PROFILER, scopes are compiled out and their arguments never evaluated.
+#ifdef ZERENGINE_PROFILER
+    #define ZERENGINE_PROFILE_SCOPE(...) const ProfilerScope profiler_scope(__VA_ARGS__)
+#else
+    #define ZERENGINE_PROFILE_SCOPE(...)
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+
+class World;
+class Sys;
+
+enum class SceneCommit: uint8_t {
+    REPLACE, // The current scene is deleted first, like load_scene() (DontDestroyOnLoad entities are kept).
+    MERGE,   // The streamed entities are added to the current scene.
+};
+
+class [[nodiscard]] LateUpgrade final {
+friend class World;
+public:
+    using RegistryMessageIndex = std::size_t;
+    using PendingSlot = uint32_t;
+
+    static constexpr RegistryMessageIndex NO_MESSAGE = std::numeric_limits<RegistryMessageIndex>::max();
+    static constexpr PendingSlot NO_SLOT = std::numeric_limits<PendingSlot>::max();
+
+private:
+    // The commands of one entity during the current frame, indexed by entity.
+    // A state whose epoch is not the current one is empty: the upgrade resets every state by incrementing the epoch.
+    struct [[nodiscard]] PendingState final {
+        std::size_t epoch = 0;
+        RegistryMessageIndex create_message = NO_MESSAGE;
+        PendingSlot add_components_slot = NO_SLOT;
+        PendingSlot remove_components_slot = NO_SLOT;
+        PendingSlot children_slot = NO_SLOT;
+        bool is_deleted = false;
+        bool is_set_active = false;
+        bool is_set_inactive = false;
+        bool is_dont_destroy_on_load = false;
+    };
+
+    // The variable length part of the states: vectors handed out during a frame and kept, with their capacity, for the next ones.
+    template <typename T>
+    class [[nodiscard]] PendingSlots final {
+    public:
+        [[nodiscard]] auto get_or_acquire(PendingSlot& slot) noexcept -> std::vector<T>& {
+            if (slot == NO_SLOT) {
+                if (nb_slots == slots.size()) {
+                    slots.emplace_back();
+                } else {
+                    slots[nb_slots].clear();
+                }
+                slot = static_cast<PendingSlot>(nb_slots++);
+            }
+            return slots[slot];
+        }
 
-static void registry_message_callback_set_active(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
-    setActiveRec(registry, entity);
-}
+        [[nodiscard]] auto operator[](const PendingSlot slot) noexcept -> std::vector<T>& {
+            return slots[slot];
+        }
 
-static void addDontDestroyOnLoadRec(Registry& registry, const Entity entity) {
-    if (registry.is_entity_exist(entity)) {
-        if (!registry.has_components(entity, {typeid(DontDestroyOnLoad).hash_code()})) {
-            registry.add_components(entity, {typeid(DontDestroyOnLoad).hash_code(), std::make_unique<DontDestroyOnLoad>()});
-            if (auto opt_children = registry.get_children(entity)) {
-                for (auto child_entity: opt_children.value()) {
-                    addDontDestroyOnLoadRec(registry, child_entity);
-                }
+        [[nodiscard]] auto operator[](const PendingSlot slot) const noexcept -> const std::vector<T>& {
+            return slots[slot];
+        }
+
+        [[nodiscard]] auto acquired() noexcept -> std::span<std::vector<T>> {
+            return {slots.data(), nb_slots};
+        }
+
+        void reset() noexcept {
+            nb_slots = 0;
+        }
+
+        [[nodiscard]] auto memory_bytes() const noexcept -> std::size_t {
+            std::size_t bytes = slots.capacity() * sizeof(std::vector<T>);
+            for (const auto& slot: slots) {
+                bytes += slot.capacity() * sizeof(T);
             }
+            return bytes;
         }
+
+    private:
+        std::vector<std::vector<T>> slots;
+        std::size_t nb_slots = 0;
+    };
+
+private:
+    LateUpgrade(Profiler& new_profiler) noexcept:
+        profiler(new_profiler) {
     }
-}
 
-static void registry_message_callback_add_font_destroy_on_load(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
-    addDontDestroyOnLoadRec(registry, entity);
-}
+private:
+    [[nodiscard]] auto get_pending_state(const Entity entity) noexcept -> PendingState& {
+        if (entity >= pending_states.size()) {
+            pending_states.resize(std::max(entity + 1, pending_states.size() * 2));
+        }
+        auto& state = pending_states[entity];
+        if (state.epoch != epoch) {
+            state = PendingState{epoch};
+        }
+        return state;
+    }
 
-static void destroyChildRec(Registry& registry, const Entity parent_entity) noexcept {
-    if (registry.is_entity_exist(parent_entity)) {
-        if (auto childrenOpt = registry.get_children(parent_entity)) {
-            for (const auto childEnt: childrenOpt.value()) {
-                destroyChildRec(registry, childEnt);
-            }
+    // nullptr when the entity has no command in this frame.
+    [[nodiscard]] auto find_pending_state(const Entity entity) const noexcept -> const PendingState* {
+        if (entity < pending_states.size() && pending_states[entity].epoch == epoch) {
+            return &pending_states[entity];
         }
-        registry.delete_entity(parent_entity);
+        return nullptr;
     }
-}
 
-static void registry_message_callback_delete_entity(Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&&, const std::vector<Type>&, const std::vector<Entity>&) {
-    destroyChildRec(registry, entity);
-}
+    [[nodiscard]] auto is_deleted(const Entity entity) const noexcept -> bool {
+        const auto state = find_pending_state(entity);
+        return state != nullptr && state->is_deleted;
+    }
 
-class World;
-class Sys;
+    [[nodiscard]] auto is_deleted_this_frame(const Entity entity) const noexcept -> bool {
+        const std::unique_lock<std::mutex> lock(mtx);
+        return is_deleted(entity);
+    }
 
-class [[nodiscard]] LateUpgrade final {
-friend class World;
-public:
-    using RegistryMessageIndex = std::size_t;
+    // nullptr when no component is added to the entity in this frame.
+    [[nodiscard]] auto find_pending_components(const Entity entity) const noexcept -> const std::vector<std::pair<Type, RegistryMessageIndex>>* {
+        const auto state = find_pending_state(entity);
+        if (state == nullptr || state->add_components_slot == NO_SLOT) {
+            return nullptr;
+        }
+        return &add_components_slots[state->add_components_slot];
+    }
 
-private:
-    LateUpgrade() = default;
+    template <typename PendingComponents>
+    [[nodiscard]] static auto find_pending_component(PendingComponents& pending_components, const Type type) noexcept -> decltype(pending_components.begin()) {
+        return std::ranges::find(pending_components, type, &std::pair<Type, RegistryMessageIndex>::first);
+    }
+
+    void reset_pending_states() noexcept {
+        epoch++;
+        add_components_slots.reset();
+        remove_components_slots.reset();
+        children_slots.reset();
+    }
 
 private:
     void create_entity(const Entity entity) noexcept {
         const std::unique_lock<std::mutex> lock(mtx);
-        if (add_entities.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::create_entity() - Impossible de creer une deuxieme entites avec un numero deja existant");
+        auto& state = get_pending_state(entity);
+        if (ZERENGINE_HAS_CHECKS && state.create_message != NO_MESSAGE) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::create_entity() - Impossible de creer une deuxieme entites avec un numero deja existant: entity[{}]", entity);
             return;
         }
-        add_entities.emplace(entity);
+        state.create_message = registry_messages.size();
         registry_messages.emplace_back(
             RegistryMessageType::CREATE_ENTITY,
             registry_message_callback_create_entity,
@@ -907,32 +2703,26 @@ private:
         );
     }
 
-    void add_components(const Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& component, const char* component_name) noexcept {
+    void add_components(const Registry& registry, const Entity entity, std::pair<Type, std::unique_ptr<IComponent>>&& component, const Storage storage, [[maybe_unused]] const char* component_name) noexcept {
         const std::unique_lock<std::mutex> lock(mtx);
-        if (registry.has_components(entity, {component.first})) {
-            std::println("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter deux fois un composant sur une entite dans les registres: entity[{}], composant[{}]", entity, component_name);
+        if (ZERENGINE_HAS_CHECKS && registry.has_components(entity, {component.first})) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter deux fois un composant sur une entite dans les registres: entity[{}], composant[{}]", entity, component_name);
             return;
         }
-        if (delEnts.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter un composant sur une entite qui vient d'etre supprimer: entity[{}], composant[{}]", entity, component_name);
+        auto& state = get_pending_state(entity);
+        if (state.is_deleted) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter un composant sur une entite qui vient d'etre supprimer: entity[{}], composant[{}]", entity, component_name);
             return;
         }
-        if (auto addCompsIt = addComps.find(entity); addCompsIt != addComps.end()) {
-            if (addCompsIt->second.contains(component.first)) {
-                std::println("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter deux fois un composant sur une entite dans le late upgrade: entity[{}], composant[{}]", entity, component_name);
-                return;
-            }
-            addCompsIt->second.emplace(component.first, registry_messages.size());
-        } else {
-            addComps.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(entity),
-                std::forward_as_tuple(std::unordered_map<Type, RegistryMessageIndex>({{component.first, registry_messages.size()}}))
-            );
+        auto& add_components = add_components_slots.get_or_acquire(state.add_components_slot);
+        if (ZERENGINE_HAS_CHECKS && find_pending_component(add_components, component.first) != add_components.end()) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::add_components() - Impossible d'ajouter deux fois un composant sur une entite dans le late upgrade: entity[{}], composant[{}]", entity, component_name);
+            return;
         }
+        add_components.emplace_back(component.first, registry_messages.size());
         registry_messages.emplace_back(
             RegistryMessageType::ADD_COMPONENT,
-            registry_message_callback_add_components,
+            storage == Storage::Sparse ? registry_message_callback_add_sparse_components : registry_message_callback_add_components,
             entity,
             std::move(std::pair<Type, std::unique_ptr<IComponent>>{std::move(component)})
         );
@@ -940,28 +2730,31 @@ private:
 
     void remove_components(const Registry& registry, const Entity entity, const std::vector<std::pair<const char*, Type>>& components) noexcept {
         const std::unique_lock<std::mutex> lock(mtx);
+        auto& state = get_pending_state(entity);
         for (const auto& [component_name, type]: components) {
-            if (!registry.has_components(entity, {type})) {
-                std::println("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer deux fois un composant sur une entite dans les registres: entity[{}], composant[{}]", entity, component_name);
+            // Added then removed in the same frame: neither the Registry nor the hooks ever see the component.
+            if (state.add_components_slot != NO_SLOT) {
+                auto& add_components = add_components_slots[state.add_components_slot];
+                if (auto add_component_it = find_pending_component(add_components, type); add_component_it != add_components.end()) {
+                    cancel_message(add_component_it->second);
+                    add_components.erase(add_component_it);
+                    continue;
+                }
+            }
+            if (ZERENGINE_HAS_CHECKS && !registry.has_components(entity, {type})) {
+                ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer deux fois un composant sur une entite dans les registres: entity[{}], composant[{}]", entity, component_name);
                 return;
             }
-            if (delEnts.contains(entity)) {
-                std::println("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer un composant sur une entite qui vient d'etre supprimer: entity[{}], composant[{}]", entity, component_name);
+            if (state.is_deleted) {
+                ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer un composant sur une entite qui vient d'etre supprimer: entity[{}], composant[{}]", entity, component_name);
                 return;
             }
-            if (auto delCompsIt = delComps.find(entity); delCompsIt != delComps.end()) {
-                if (delCompsIt->second.contains(type)) {
-                    std::println("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer deux fois un composant sur une entite dans le late upgrade: entity[{}], composant[{}]", entity, component_name);
-                    return;
-                }
-                delCompsIt->second.emplace(type);
-            } else {
-                delComps.emplace(
-                    std::piecewise_construct,
-                    std::forward_as_tuple(entity),
-                    std::forward_as_tuple(std::initializer_list<Type>{type})
-                );
+            auto& remove_components = remove_components_slots.get_or_acquire(state.remove_components_slot);
+            if (ZERENGINE_HAS_CHECKS && std::ranges::find(remove_components, type) != remove_components.end()) {
+                ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::remove_components() - Impossible de supprimer deux fois un composant sur une entite dans le late upgrade: entity[{}], composant[{}]", entity, component_name);
+                return;
             }
+            remove_components.emplace_back(type);
             registry_messages.emplace_back(
                 RegistryMessageType::REMOVE_COMPONENT,
                 registry_message_callback_remove_components,
@@ -973,21 +2766,45 @@ private:
 
     void delete_entity(const Registry& registry, const Entity entity) noexcept {
         const std::unique_lock<std::mutex> lock(mtx);
-        if (delEnts.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::delete_entity() - Impossible de supprimer deux fois la meme entite dans le late upgrade: entity[{}]", entity);
+        delete_entity_internal(registry, entity);
+    }
+
+    void delete_entity_internal(const Registry& registry, const Entity entity) noexcept {
+        auto& state = get_pending_state(entity);
+        if (state.is_deleted) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::delete_entity() - Impossible de supprimer deux fois la meme entite dans le late upgrade: entity[{}]", entity);
             return;
         }
-        // addComps.erase(entity);
-        // delComps.erase(entity);
-        // setInactiveEnts.erase(entity);
-        // setActiveEnts.erase(entity);
-        // addDontDestroyOnLoadEnts.erase(entity);
-        // addParentChildren.erase(entity);
-        // for (auto& [_, children]: addParentChildren) {
-        //     children.erase(entity);
-        // }
-        delEnts.emplace(entity);
-        delComps.emplace(entity, registry.get_all_components_types(entity) | std::ranges::to<std::unordered_set<Type>>());
+        // The components added this frame are never applied: no add hook for a component the entity loses in the same upgrade.
+        if (state.add_components_slot != NO_SLOT) {
+            auto& add_components = add_components_slots[state.add_components_slot];
+            for (const auto message_index: std::views::values(add_components)) {
+                cancel_message(message_index);
+            }
+            add_components.clear();
+        }
+        state.is_deleted = true;
+        // Created then deleted in the same frame: the entity never reaches the Registry, no hook is called.
+        if (state.create_message != NO_MESSAGE) {
+            // The children appended this frame go with it, as destroyChildRec would have deleted them once appended.
+            std::vector<Entity> children_entities;
+            if (state.children_slot != NO_SLOT) {
+                children_entities = children_slots[state.children_slot];
+            }
+            cancel_message(std::exchange(state.create_message, NO_MESSAGE));
+            cancel_entity_messages(state, entity);
+            cancelled_entities.emplace_back(entity);
+            for (const auto child_entity: children_entities) {
+                if (!is_deleted(child_entity)) {
+                    delete_entity_internal(registry, child_entity);
+                }
+            }
+            return;
+        }
+        // The components removed earlier in the frame are the only ones the hooks see removed.
+        if (state.remove_components_slot == NO_SLOT) {
+            remove_components_slots.get_or_acquire(state.remove_components_slot) = registry.get_all_components_types(entity);
+        }
         registry_messages.emplace_back(
             RegistryMessageType::DELETE_ENTITY,
             registry_message_callback_delete_entity,
@@ -995,30 +2812,22 @@ private:
         );
     }
 
-    void append_children(const Registry& registry, const Entity parent_entity, const std::vector<Entity>& children_entity) {
+    void append_children(const Registry&, const Entity parent_entity, const std::vector<Entity>& children_entity) {
         const std::unique_lock<std::mutex> lock(mtx);
-        auto new_children_entity = children_entity;
-        if (delEnts.contains(parent_entity)) {
-            std::println("ZerEngine::LateUpgrade::append_children() - Impossible de faire une hierarchie sur une entite supprime: entity[{}]", parent_entity);
+        if (is_deleted(parent_entity)) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::append_children() - Impossible de faire une hierarchie sur une entite supprime: entity[{}]", parent_entity);
             return;
         }
-        std::size_t i = 0;
-        for (const auto child_entity: children_entity) {
-            if (delEnts.contains(child_entity)) {
-                std::println("ZerEngine::LateUpgrade::append_children() - Impossible de faire une hierarchie avec une entite supprime: entity[{}]", child_entity);
-                new_children_entity.erase(new_children_entity.begin() + i);
+        auto new_children_entity = children_entity;
+        std::erase_if(new_children_entity, [&](const Entity child_entity) {
+            if (is_deleted(child_entity)) {
+                ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::append_children() - Impossible de faire une hierarchie avec une entite supprime: entity[{}]", child_entity);
+                return true;
             }
-            i++;
-        }
-        if (addParentChildren.contains(parent_entity)) {
-            addParentChildren.at(parent_entity).insert(new_children_entity.begin(), new_children_entity.end());
-        } else {
-            addParentChildren.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(parent_entity),
-                std::forward_as_tuple(std::unordered_set<Entity>(new_children_entity.begin(), new_children_entity.end()))
-            );
-        }
+            return false;
+        });
+        auto& pending_children = children_slots.get_or_acquire(get_pending_state(parent_entity).children_slot);
+        pending_children.insert(pending_children.end(), new_children_entity.begin(), new_children_entity.end());
         registry_messages.emplace_back(
             RegistryMessageType::APPEND_CHILDREN,
             registry_message_callback_append_children,
@@ -1028,15 +2837,17 @@ private:
     }
 
     void set_active(const Entity entity) {
-        if (setActiveEnts.contains(entity)) {
-            std::cerr << "ZerEngine::LateUpgrade::set_active() - Impossible de rendre 2 fois actif une entité: entity[" << entity << "]" << std::endl;
+        const std::unique_lock<std::mutex> lock(mtx);
+        auto& state = get_pending_state(entity);
+        if (ZERENGINE_HAS_CHECKS && state.is_set_active) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::set_active() - Impossible de rendre 2 fois actif une entité: entity[{}]", entity);
             return;
         }
-        if (delEnts.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::set_active() - Impossible de mettre une entite IsActive: entity[{}]", entity);
+        if (state.is_deleted) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::set_active() - Impossible de mettre une entite IsActive: entity[{}]", entity);
             return;
         }
-        setActiveEnts.emplace(entity);
+        state.is_set_active = true;
         registry_messages.emplace_back(
             RegistryMessageType::SET_ACTIVE,
             registry_message_callback_set_active,
@@ -1045,15 +2856,17 @@ private:
     }
 
     void set_inactive(const Entity entity) {
-        if (setInactiveEnts.contains(entity)) {
-            std::cerr << "ZerEngine::LateUpgrade::set_inactive() - Impossible de rendre 2 fois inactif une entité: entity[" << entity << "]" << std::endl;
+        const std::unique_lock<std::mutex> lock(mtx);
+        auto& state = get_pending_state(entity);
+        if (ZERENGINE_HAS_CHECKS && state.is_set_inactive) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::set_inactive() - Impossible de rendre 2 fois inactif une entité: entity[{}]", entity);
             return;
         }
-        if (delEnts.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::set_inactive() - Impossible de mettre une entite IsInactive: entity[{}]", entity);
+        if (state.is_deleted) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::set_inactive() - Impossible de mettre une entite IsInactive: entity[{}]", entity);
             return;
         }
-        setInactiveEnts.emplace(entity);
+        state.is_set_inactive = true;
         registry_messages.emplace_back(
             RegistryMessageType::SET_INACTIVE,
             registry_message_callback_set_inactive,
@@ -1062,15 +2875,17 @@ private:
     }
 
     void add_dont_destroy_on_load(const Entity entity) {
-        if (addDontDestroyOnLoadEnts.contains(entity)) {
-            std::cerr << "ZerEngine::LateUpgrade::add_dont_destroy_on_load() - Impossible de mettre dont destroy on load sur une entité: entity[" << entity << "]" << std::endl;
+        const std::unique_lock<std::mutex> lock(mtx);
+        auto& state = get_pending_state(entity);
+        if (ZERENGINE_HAS_CHECKS && state.is_dont_destroy_on_load) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::add_dont_destroy_on_load() - Impossible de mettre dont destroy on load sur une entité: entity[{}]", entity);
             return;
         }
-        if (delEnts.contains(entity)) {
-            std::println("ZerEngine::LateUpgrade::add_dont_destroy_on_load() - Impossible de mettre une entite DontDestroyOnLoad: entity[{}]", entity);
+        if (state.is_deleted) {
+            ZERENGINE_DIAGNOSTIC("ZerEngine::LateUpgrade::add_dont_destroy_on_load() - Impossible de mettre une entite DontDestroyOnLoad: entity[{}]", entity);
             return;
         }
-        addDontDestroyOnLoadEnts.emplace(entity);
+        state.is_dont_destroy_on_load = true;
         registry_messages.emplace_back(
             RegistryMessageType::ADD_DONT_DESTROY_ON_LOAD,
             registry_message_callback_add_font_destroy_on_load,
@@ -1082,7 +2897,89 @@ private:
         scene_messages.emplace_back(new_scene);
     }
 
+    void cancel_message(const RegistryMessageIndex message_index) noexcept {
+        auto& message = registry_messages[message_index];
+        message.message_type = RegistryMessageType::CANCELLED;
+        message.component.second.reset();
+    }
+
+    // Rare path (hierarchy or activation commands on an entity deleted in the frame it was created): linear scan.
+    void cancel_entity_messages(PendingState& state, const Entity entity) noexcept {
+        const bool is_parent = std::exchange(state.children_slot, NO_SLOT) != NO_SLOT;
+        const bool is_inactive = std::exchange(state.is_set_inactive, false);
+        const bool is_active = std::exchange(state.is_set_active, false);
+        const bool is_dont_destroy = std::exchange(state.is_dont_destroy_on_load, false);
+        bool is_child = false;
+        for (auto& children_entities: children_slots.acquired()) {
+            is_child |= std::erase(children_entities, entity) != 0;
+        }
+        if (!is_parent && !is_inactive && !is_active && !is_dont_destroy && !is_child) {
+            return;
+        }
+        for (std::size_t i = 0; i < registry_messages.size(); i++) {
+            auto& message = registry_messages[i];
+            if (message.message_type == RegistryMessageType::CANCELLED) {
+                continue;
+            }
+            if (message.entity == entity) {
+                cancel_message(i);
+            } else if (message.message_type == RegistryMessageType::APPEND_CHILDREN) {
+                std::erase(message.children_entities, entity);
+            }
+        }
+    }
+
+    [[nodiscard]] auto has_pending_commands(const Entity entity) noexcept -> bool {
+        const std::unique_lock<std::mutex> lock(mtx);
+        const auto state = find_pending_state(entity);
+        if (state == nullptr) {
+            return false;
+        }
+        return state->create_message != NO_MESSAGE || (state->add_components_slot != NO_SLOT && !add_components_slots[state->add_components_slot].empty())
+            || state->is_deleted || state->remove_components_slot != NO_SLOT || state->children_slot != NO_SLOT
+            || state->is_set_inactive || state->is_set_active || state->is_dont_destroy_on_load;
+    }
+
+    // The ids of the entities moved out by World::transfer() are recycled by the next upgrade, as the deleted ones.
+    void release_transferred_entities(const std::vector<Entity>& entities) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        transferred_entities.insert(transferred_entities.end(), entities.begin(), entities.end());
+    }
+
+    [[nodiscard]] auto memory_bytes() noexcept -> std::size_t {
+        const std::unique_lock<std::mutex> lock(mtx);
+        std::size_t bytes = registry_messages.capacity() * sizeof(RegistryMessage) + scene_messages.capacity() * sizeof(void(*)(SceneSystem, World&));
+        for (const auto& message: registry_messages) {
+            if (message.component.second != nullptr) {
+                if (auto opt_info = ComponentInfos::get(message.component.first)) {
+                    bytes += opt_info->size;
+                }
+            }
+            bytes += message.component_types.capacity() * sizeof(Type) + message.children_entities.capacity() * sizeof(Entity);
+        }
+        bytes += pending_states.capacity() * sizeof(PendingState);
+        bytes += add_components_slots.memory_bytes() + remove_components_slots.memory_bytes() + children_slots.memory_bytes();
+        return bytes;
+    }
+
     void load_scene_internal(World& world, Registry& registry, Sys& sys, void(*const new_scene)(SceneSystem, World&)) noexcept {
+        clear_scene(world, registry, sys);
+
+        ZERENGINE_PROFILE_SCOPE(profiler, "SceneSystem", Profiler::system_address(new_scene));
+        new_scene({}, world);
+    }
+
+    // Moves the entities built in stage into registry at once: rows are moved, not copied, then the create hooks run.
+    void commit_scene(World& world, Registry& registry, Sys& sys, Registry& stage, const SceneCommit scene_commit) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "LateUpgrade::commit_scene");
+        if (scene_commit == SceneCommit::REPLACE) {
+            clear_scene(world, registry, sys);
+        }
+        upgrade_hook_commit_scene(world, registry, sys, stage.transfer_all(registry));
+    }
+
+    // Deletes every entity but the DontDestroyOnLoad ones, after the pending commands.
+    void clear_scene(World& world, Registry& registry, Sys& sys) noexcept {
         std::unordered_set<Entity> dont_destroy_entities;
         for (auto [dont_destroy_entity]: registry.query({typeid(DontDestroyOnLoad).hash_code()}, {})) {
             dont_destroy_entities.emplace(dont_destroy_entity);
@@ -1091,14 +2988,17 @@ private:
             delete_entity(registry, entity);
         }
         for (auto&& [callback, entity, components, component_types, children_entities, message_type]: registry_messages) {
+            if (message_type == RegistryMessageType::CANCELLED) {
+                continue;
+            }
             switch (message_type) {
                 case RegistryMessageType::REMOVE_COMPONENT:
-                    for (const auto remove_component_type: delComps.at(entity)) {
+                    for (const auto remove_component_type: remove_components_slots[pending_states[entity].remove_components_slot]) {
                         upgrade_hook_remove_component(world, sys, entity, remove_component_type);
                     }
                     break;
                 case RegistryMessageType::DELETE_ENTITY:
-                    for (const auto type: delComps.at(entity)) {
+                    for (const auto type: remove_components_slots[pending_states[entity].remove_components_slot]) {
                         upgrade_hook_remove_component(world, sys, entity, type);
                         upgrade_hook_delete_entity_with_component(world, sys, entity, type);
                     }
@@ -1110,12 +3010,12 @@ private:
 
             switch (message_type) {
                 case RegistryMessageType::ADD_COMPONENT:
-                    if (add_entities.contains(entity)) {
-                        for (const auto [add_component_type, _]: addComps.at(entity)) {
+                    if (pending_states[entity].create_message != NO_MESSAGE) {
+                        for (const auto& [add_component_type, _]: add_components_slots[pending_states[entity].add_components_slot]) {
                             upgrade_hook_create_entity_with_component(world, sys, entity, add_component_type);
                         }
                     } else {
-                        for (const auto [add_component_type, _]: addComps.at(entity)) {
+                        for (const auto& [add_component_type, _]: add_components_slots[pending_states[entity].add_components_slot]) {
                             upgrade_hook_add_component(world, sys, entity, add_component_type);
                         }
                     }
@@ -1123,30 +3023,27 @@ private:
                 default: break;
             }
         }
-        add_entities.clear();
-        addComps.clear();
-        delComps.clear();
-        delEnts.clear();
-        addParentChildren.clear();
-        setInactiveEnts.clear();
-        setActiveEnts.clear();
-        addDontDestroyOnLoadEnts.clear();
+        reset_pending_states();
 
         registry_messages.clear();
-        new_scene({}, world);
+        release_unused_entities(registry);
     }
 
 private:
     void upgrade(World& world, Registry& registry, Sys& sys) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "LateUpgrade::upgrade");
         for (auto&& [callback, entity, components, component_types, children_entities, message_type]: registry_messages) {
+            if (message_type == RegistryMessageType::CANCELLED) {
+                continue;
+            }
             switch (message_type) {
                 case RegistryMessageType::REMOVE_COMPONENT:
-                    for (const auto remove_component_type: delComps.at(entity)) {
+                    for (const auto remove_component_type: remove_components_slots[pending_states[entity].remove_components_slot]) {
                         upgrade_hook_remove_component(world, sys, entity, remove_component_type);
                     }
                     break;
                 case RegistryMessageType::DELETE_ENTITY:
-                    for (const auto type: delComps.at(entity)) {
+                    for (const auto type: remove_components_slots[pending_states[entity].remove_components_slot]) {
                         upgrade_hook_remove_component(world, sys, entity, type);
                         upgrade_hook_delete_entity_with_component(world, sys, entity, type);
                     }
@@ -1158,12 +3055,12 @@ private:
 
             switch (message_type) {
                 case RegistryMessageType::ADD_COMPONENT:
-                    if (add_entities.contains(entity)) {
-                        for (const auto [add_component_type, _]: addComps.at(entity)) {
+                    if (pending_states[entity].create_message != NO_MESSAGE) {
+                        for (const auto& [add_component_type, _]: add_components_slots[pending_states[entity].add_components_slot]) {
                             upgrade_hook_create_entity_with_component(world, sys, entity, add_component_type);
                         }
                     } else {
-                        for (const auto [add_component_type, _]: addComps.at(entity)) {
+                        for (const auto& [add_component_type, _]: add_components_slots[pending_states[entity].add_components_slot]) {
                             upgrade_hook_add_component(world, sys, entity, add_component_type);
                         }
                     }
@@ -1172,22 +3069,30 @@ private:
             }
         }
 
-        add_entities.clear();
-        addComps.clear();
-        delComps.clear();
-        delEnts.clear();
-        addParentChildren.clear();
-        setInactiveEnts.clear();
-        setActiveEnts.clear();
-        addDontDestroyOnLoadEnts.clear();
+        reset_pending_states();
 
         registry_messages.clear();
+        release_unused_entities(registry);
 
         for (const auto& new_scene: scene_messages) {
             load_scene_internal(world, registry, sys, new_scene);
         }
 
         scene_messages.clear();
+
+        registry.apply_row_orders();
+        registry.publish_released_entities();
+    }
+
+    void release_unused_entities(Registry& registry) noexcept {
+        for (const auto entity: cancelled_entities) {
+            registry.release_entity_token(entity);
+        }
+        cancelled_entities.clear();
+        for (const auto entity: transferred_entities) {
+            registry.release_entity_token(entity);
+        }
+        transferred_entities.clear();
     }
 
     // Co-dependency: see after class Sys final;
@@ -1195,31 +3100,104 @@ private:
     void upgrade_hook_create_entity_with_component(World&, Sys&, const Entity, const Type) noexcept;
     void upgrade_hook_remove_component(World&, Sys&, const Entity, const Type) noexcept;
     void upgrade_hook_delete_entity_with_component(World&, Sys&, const Entity, const Type) noexcept;
+    void upgrade_hook_commit_scene(World&, const Registry&, Sys&, const std::vector<Entity>&) noexcept;
 
 private:
-    std::mutex mtx;
-    std::unordered_set<Entity> add_entities;
-    std::unordered_map<Entity, std::unordered_map<Type, RegistryMessageIndex>> addComps;
-    std::unordered_set<Entity> delEnts;
-    std::unordered_map<Entity, std::unordered_set<Type>> delComps;
-    std::unordered_map<Entity, std::unordered_set<Entity>> addParentChildren;
-    std::unordered_set<Entity> setInactiveEnts;
-    std::unordered_set<Entity> setActiveEnts;
-    std::unordered_set<Entity> addDontDestroyOnLoadEnts;
+    Profiler& profiler;
+    // Also taken by the reads of World: a command from another thread may grow the tables.
+    mutable std::mutex mtx;
+    std::size_t epoch = 1;
+    std::vector<PendingState> pending_states;
+    PendingSlots<std::pair<Type, RegistryMessageIndex>> add_components_slots;
+    PendingSlots<Type> remove_components_slots;
+    PendingSlots<Entity> children_slots;
 
     std::vector<RegistryMessage> registry_messages;
+    std::vector<Entity> cancelled_entities;
+    std::vector<Entity> transferred_entities;
 
     std::vector<void(*)(SceneSystem, World&)> scene_messages;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+class [[nodiscard]] IEvents: public IResource {
+friend class TypeMap;
+protected:
+    constexpr IEvents() noexcept = default;
+
+private:
+    virtual void swap_buffers() noexcept = 0;
+};
+
+// Double-buffered event channel, added as a resource: ZerEngine().add_events<Hit>().
+// Events sent during a frame are readable by every system during the next one, the buffers are swapped after the last upgrade of the frame.
+template <typename T>
+class [[nodiscard]] Events final: public IEvents {
+public:
+    Events() noexcept = default;
+    Events(Events&&) noexcept = default;
+
+public:
+    // From any thread, without lock.
+    template <typename... Args>
+    void send(Args&&... args) noexcept {
+        sent_events.emplace_back(std::forward<Args>(args)...);
+    }
+
+    // The events sent during the previous frame, grouped by sending thread.
+    [[nodiscard]] auto read() const noexcept -> std::span<const T> {
+        return readable_events;
+    }
+
+    [[nodiscard]] auto begin() const noexcept -> std::vector<T>::const_iterator {
+        return readable_events.begin();
+    }
+
+    [[nodiscard]] auto end() const noexcept -> std::vector<T>::const_iterator {
+        return readable_events.end();
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t {
+        return readable_events.size();
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool {
+        return readable_events.empty();
+    }
+
+private:
+    void swap_buffers() noexcept override {
+        readable_events.clear();
+        sent_events.drain(readable_events);
+    }
+
+private:
+    ThreadBuffers<T> sent_events;
+    std::vector<T> readable_events;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
 class [[nodiscard]] TypeMap final {
 friend class World;
 friend class ZerEngine;
 private:
-    constexpr void emplace(const Type type, std::unique_ptr<IResource>&& resource) noexcept {
-        type_map.emplace(type, std::move(resource));
+    template <typename T>
+    constexpr void emplace(std::unique_ptr<T>&& resource) noexcept {
+        auto new_resource = resource.get();
+        if (type_map.emplace(typeid(T).hash_code(), std::move(resource)).second) {
+            resources_bytes += sizeof(T);
+            if constexpr (std::derived_from<T, IEvents>) {
+                event_channels.emplace_back(new_resource);
+            }
+        }
+    }
+
+    void swap_event_buffers() noexcept {
+        for (auto event_channel: event_channels) {
+            event_channel->swap_buffers();
+        }
     }
 
     [[nodiscard]] constexpr std::unique_ptr<IResource>& get(const Type type) noexcept {
@@ -1230,12 +3208,24 @@ private:
         return type_map.at(type);
     }
 
+    [[nodiscard]] auto contains(const Type type) const noexcept -> bool {
+        return type_map.contains(type);
+    }
+
     constexpr void clear() noexcept {
+        event_channels.clear();
         type_map.clear();
+        resources_bytes = 0;
+    }
+
+    [[nodiscard]] constexpr auto memory_bytes() const noexcept -> std::size_t {
+        return resources_bytes + hash_container_bytes(type_map);
     }
 
 private:
     std::unordered_map<Type, std::unique_ptr<IResource>> type_map;
+    std::vector<IEvents*> event_channels;
+    std::size_t resources_bytes {0};
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -1438,70 +3428,170 @@ private:
     const std::vector<MainUnscaledFixedSet> subSets;
 };
 
+template <auto System, typename Phase>
+concept IsSystemOfPhaseConcept = std::is_invocable_v<decltype(System), Phase, World&>;
+
+template <auto System>
+concept IsScheduleSystemConcept = [] -> bool {
+    static_assert(
+        IsSystemOfPhaseConcept<System, StartSystem> ||
+        IsSystemOfPhaseConcept<System, MainSystem> ||
+        IsSystemOfPhaseConcept<System, MainFixedSystem> ||
+        IsSystemOfPhaseConcept<System, MainUnscaledFixedSystem> ||
+        IsSystemOfPhaseConcept<System, LateSystem> ||
+        IsSystemOfPhaseConcept<System, LateFixedSystem> ||
+        IsSystemOfPhaseConcept<System, LateUnscaledFixedSystem>,
+        "Impossible d'ajouter a un Schedule un systeme qui ne soit pas Start, Main ou Late (Fixed, UnscaledFixed)"
+    );
+    return true;
+}();
+
+// Systems composed at compile time: ZerEngine().add_systems(schedule<init_sys, move_sys, late_sys>).
+// Each phase of a schedule is a single function pointer calling its systems in order, which the compiler can inline.
+template <auto... Systems>
+requires (IsScheduleSystemConcept<Systems> && ...)
+struct [[nodiscard]] Schedule final {
+    template <typename Phase>
+    static constexpr bool has_phase = (IsSystemOfPhaseConcept<Systems, Phase> || ...);
+
+    template <typename Phase>
+    static void run(World& world) noexcept {
+        ([&world] {
+            if constexpr (IsSystemOfPhaseConcept<Systems, Phase>) {
+                Systems(Phase(), world);
+            }
+        }(), ...);
+    }
+};
+template <auto... Systems>
+constexpr inline const Schedule<Systems...> schedule;
+
 ///////////////////////////////////////////////////////////////////////////////////
 
 class World;
 
+// Workers of the ThreadPool of a World, set on the ZerEngine before run(): the threads are spawned by the first threaded set.
+struct [[nodiscard]] ThreadPoolConfig final {
+    // One worker per core, the last one is left to the main thread.
+    [[nodiscard]] static auto default_nb_workers() noexcept -> std::size_t {
+        return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    // 0: the threaded sets run on the main thread.
+    std::size_t nb_workers = default_nb_workers();
+    // Worker i only runs on the CPUs listed in worker_cpus[i % worker_cpus.size()], whatever their number. Empty: left to the OS.
+    std::vector<std::vector<std::size_t>> worker_cpus;
+    // Time an idle worker spins waiting for the next set before sleeping on the condition variable.
+    std::chrono::microseconds spin_duration {50};
+};
+
 class ThreadPool final {
 friend class Sys;
-private:
-    ThreadPool(World& newWorld, std::size_t newNbThreads) noexcept:
+public:
+    static constexpr std::size_t CALLBACK_BATCH_SIZE = 64;
+
+public:
+    ThreadPool(World& newWorld, Profiler& new_profiler, const ThreadPoolConfig& config) noexcept:
         world(newWorld),
-        nbThreads(newNbThreads) {
+        profiler(new_profiler),
+        nbThreads(config.nb_workers),
+        spin_duration(config.spin_duration) {
         for (std::size_t i = 0; i < nbThreads; i++) {
-            threads.emplace_back([this] {
+            auto cpus = config.worker_cpus.empty() ? std::vector<std::size_t>() : config.worker_cpus[i % config.worker_cpus.size()];
+            threads.emplace_back([this, cpus = std::move(cpus)] {
+                if (!cpus.empty()) {
+                    set_current_thread_affinity(cpus);
+                }
                 task();
             });
         }
     }
 
-private:
     ~ThreadPool() noexcept {
         stop();
         for (auto& thread: threads) {
             thread.join();
         }
+        while (!coroutines.empty()) {
+            coroutines.front().destroy();
+            coroutines.pop();
+        }
     }
 
     void addTasks(const std::vector<void(*)(ThreadedSystem, World&)>& newTasks) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
         tasks.emplace_back(newTasks);
     }
 
     void addFixedTasks(const std::vector<void(*)(ThreadedFixedSystem, World&)>& newTasks) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
         fixedTasks.emplace_back(newTasks);
     }
 
     void addUnscaledFixedTasks(const std::vector<void(*)(ThreadedUnscaledFixedSystem, World&)>& newTasks) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
         unscaledFixedTasks.emplace_back(newTasks);
     }
 
+    void addCallbacks(std::vector<std::pair<void(*)(CallbackSystem, World&, const Entity), Entity>>&& newCallbacks) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        callbackTasks = std::move(newCallbacks);
+    }
+
     void run() noexcept {
-        if (!tasks.empty()) {
-            nbTasksDone = tasks[0].size();
-            cvTask.notify_all();
-        } else {
-            nbTasksDone = 0;
-        }
+        const std::unique_lock<std::mutex> lock(mtx);
+        publish_work(tasks.empty() ? 0 : tasks[0].size());
     }
 
     void fixedRun() noexcept {
-        if (!fixedTasks.empty()) {
-            nbTasksDone = fixedTasks[0].size();
-            cvTask.notify_all();
-        } else {
-            nbTasksDone = 0;
-        }
+        const std::unique_lock<std::mutex> lock(mtx);
+        publish_work(fixedTasks.empty() ? 0 : fixedTasks[0].size());
     }
 
     void unscaledFixedRun() noexcept {
-        if (!unscaledFixedTasks.empty()) {
-            nbTasksDone = unscaledFixedTasks[0].size();
+        const std::unique_lock<std::mutex> lock(mtx);
+        publish_work(unscaledFixedTasks.empty() ? 0 : unscaledFixedTasks[0].size());
+    }
+
+    // Workers take the callbacks by batches of CALLBACK_BATCH_SIZE.
+    void callbacksRun() noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        publish_work((callbackTasks.size() + CALLBACK_BATCH_SIZE - 1) / CALLBACK_BATCH_SIZE);
+    }
+
+    // Resumed by the first idle worker: the sets keep the priority.
+    void addCoroutine(const std::coroutine_handle<> coroutine) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        coroutines.push(coroutine);
+        work_epoch.fetch_add(1, std::memory_order_release);
+        cvTask.notify_one();
+    }
+
+    // Before an upgrade: waits for the coroutines running on the workers, the queued ones are held until release_coroutines().
+    void hold_coroutines() noexcept {
+        std::unique_lock<std::mutex> lock(mtx);
+        isCoroutinesHeld = true;
+        cvFinished.wait(lock, [&]() {
+            return nbCoroutines == 0;
+        });
+    }
+
+    void release_coroutines() noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        isCoroutinesHeld = false;
+        if (!coroutines.empty()) {
+            work_epoch.fetch_add(1, std::memory_order_release);
             cvTask.notify_all();
-        } else {
-            nbTasksDone = 0;
         }
     }
 
+    void callbacksWait() noexcept {
+        std::unique_lock<std::mutex> lock(mtx);
+        cvFinished.wait(lock, [&]() {
+            return (callbackTasks.empty() && (nbTasks == 0));
+        });
+    }
+
     void wait() noexcept {
         std::unique_lock<std::mutex> lock(mtx);
         cvFinished.wait(lock, [&]() {
@@ -1533,17 +3623,87 @@ private:
     }
 
 private:
+    [[nodiscard]] auto has_work() const noexcept -> bool {
+        return (nbTasks + nbCoroutines < nbThreads) && (((!tasks.empty() || !fixedTasks.empty() || !unscaledFixedTasks.empty() || !callbackTasks.empty()) && nbTasksDone != 0) || (!coroutines.empty() && !isCoroutinesHeld) || isStop);
+    }
+
+    // mtx locked: spinning workers watch work_epoch, sleeping ones cvTask.
+    void publish_work(const std::size_t nb_new_tasks) noexcept {
+        nbTasksDone = nb_new_tasks;
+        if (nbTasksDone != 0) {
+            work_epoch.fetch_add(1, std::memory_order_release);
+            cvTask.notify_all();
+        }
+    }
+
+    // The next set of a frame usually comes within microseconds, well under the wake-up latency of the condition variable.
+    void spin_for_work(const std::size_t last_work_epoch) const noexcept {
+        if (spin_duration <= std::chrono::microseconds::zero()) {
+            return;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + spin_duration;
+        while (work_epoch.load(std::memory_order_acquire) == last_work_epoch && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Sized on the highest CPU of the list: not bounded by CPU_SETSIZE.
+    static void set_current_thread_affinity([[maybe_unused]] const std::vector<std::size_t>& cpus) noexcept {
+#ifdef __linux__
+        const auto max_cpu = std::ranges::max(cpus);
+        cpu_set_t* const cpu_set = CPU_ALLOC(max_cpu + 1);
+        if (cpu_set == nullptr) {
+            ZERENGINE_DIAGNOSTIC("ThreadPool: Impossible d'allouer le masque d'affinité d'un worker jusqu'au CPU {}", max_cpu);
+            return;
+        }
+        const auto cpu_set_size = CPU_ALLOC_SIZE(max_cpu + 1);
+        CPU_ZERO_S(cpu_set_size, cpu_set);
+        for (const auto cpu: cpus) {
+            CPU_SET_S(cpu, cpu_set_size, cpu_set);
+        }
+        if (pthread_setaffinity_np(pthread_self(), cpu_set_size, cpu_set) != 0) {
+            ZERENGINE_DIAGNOSTIC("ThreadPool: Impossible de fixer l'affinité d'un worker sur ses {} CPU(s), jusqu'au CPU {}", cpus.size(), max_cpu);
+        }
+        CPU_FREE(cpu_set);
+#endif
+    }
+
     void task() noexcept {
         std::srand(std::time(nullptr));
         std::unique_lock<std::mutex> lock(mtx);
         while (true) {
+            if (!has_work()) {
+                const auto last_work_epoch = work_epoch.load(std::memory_order_relaxed);
+                lock.unlock();
+                spin_for_work(last_work_epoch);
+                lock.lock();
+            }
             cvTask.wait(lock, [&]() {
-                return (nbTasks < nbThreads) && (((!tasks.empty() || !fixedTasks.empty()) && nbTasksDone != 0) || isStop);
+                return has_work();
             });
-            if (isStop && tasks.empty() && fixedTasks.empty()) {
+            if (isStop && nbTasksDone == 0) {
                 return;
             }
 
+            if (nbTasksDone == 0) {
+                const auto coroutine = coroutines.front();
+                coroutines.pop();
+                nbCoroutines++;
+                lock.unlock();
+
+                {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "Coroutine");
+                    coroutine.resume();
+                }
+
+                lock.lock();
+                nbCoroutines--;
+                if (nbCoroutines == 0 && isCoroutinesHeld) {
+                    cvFinished.notify_all();
+                }
+                continue;
+            }
+
             if (!tasks.empty()) {
                 nbTasks++;
                 auto newTask = tasks[0].back();
@@ -1551,7 +3711,10 @@ private:
                 nbTasksDone--;
                 lock.unlock();
 
-                newTask({}, world);
+                {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedSystem", Profiler::system_address(newTask));
+                    newTask({}, world);
+                }
 
                 lock.lock();
                 nbTasks--;
@@ -1559,8 +3722,7 @@ private:
                 if (nbTasksDone == 0 && nbTasks == 0) {
                     tasks.erase(tasks.begin());
                     if (!tasks.empty()) {
-                        nbTasksDone = tasks[0].size();
-                        cvFinished.notify_one();
+                        publish_work(tasks[0].size());
                     }
                 }
 
@@ -1574,7 +3736,10 @@ private:
                 nbTasksDone--;
                 lock.unlock();
 
-                newTask({}, world);
+                {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedFixedSystem", Profiler::system_address(newTask));
+                    newTask({}, world);
+                }
 
                 lock.lock();
                 nbTasks--;
@@ -1582,8 +3747,7 @@ private:
                 if (nbTasksDone == 0 && nbTasks == 0) {
                     fixedTasks.erase(fixedTasks.begin());
                     if (!fixedTasks.empty()) {
-                        nbTasksDone = fixedTasks[0].size();
-                        cvFinished.notify_one();
+                        publish_work(fixedTasks[0].size());
                     }
                 }
 
@@ -1597,7 +3761,10 @@ private:
                 nbTasksDone--;
                 lock.unlock();
 
-                newTask({}, world);
+                {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedUnscaledFixedSystem", Profiler::system_address(newTask));
+                    newTask({}, world);
+                }
 
                 lock.lock();
                 nbTasks--;
@@ -1605,14 +3772,33 @@ private:
                 if (nbTasksDone == 0 && nbTasks == 0) {
                     unscaledFixedTasks.erase(unscaledFixedTasks.begin());
                     if (!unscaledFixedTasks.empty()) {
-                        nbTasksDone = unscaledFixedTasks[0].size();
-                        cvFinished.notify_one();
+                        publish_work(unscaledFixedTasks[0].size());
                     }
                 }
 
                 if (unscaledFixedTasks.empty() && nbTasks == 0) {
                     cvFinished.notify_one();
                 }
+            } else if (!callbackTasks.empty()) {
+                nbTasks++;
+                nbTasksDone--;
+                const auto batch_begin = nbTasksDone * CALLBACK_BATCH_SIZE;
+                const auto batch_end = std::min(batch_begin + CALLBACK_BATCH_SIZE, callbackTasks.size());
+                lock.unlock();
+
+                for (auto i = batch_begin; i < batch_end; i++) {
+                    const auto [callback, entity] = callbackTasks[i];
+                    ZERENGINE_PROFILE_SCOPE(profiler, "CallbackSystem", Profiler::system_address(callback));
+                    callback({}, world, entity);
+                }
+
+                lock.lock();
+                nbTasks--;
+
+                if (nbTasksDone == 0 && nbTasks == 0) {
+                    callbackTasks.clear();
+                    cvFinished.notify_one();
+                }
             }
         }
     }
@@ -1620,22 +3806,30 @@ private:
     void stop() noexcept {
         const std::unique_lock<std::mutex> lock(mtx);
         isStop = true;
+        work_epoch.fetch_add(1, std::memory_order_release);
         cvTask.notify_all();
     }
 
 private:
     World& world;
+    Profiler& profiler;
     std::vector<std::vector<void(*)(ThreadedSystem, World&)>> tasks;
     std::vector<std::vector<void(*)(ThreadedFixedSystem, World&)>> fixedTasks;
     std::vector<std::vector<void(*)(ThreadedUnscaledFixedSystem, World&)>> unscaledFixedTasks;
+    std::vector<std::pair<void(*)(CallbackSystem, World&, const Entity), Entity>> callbackTasks;
+    std::queue<std::coroutine_handle<>> coroutines;
     std::mutex mtx;
     std::size_t nbTasksDone {0};
     std::condition_variable cvTask;
     std::condition_variable cvFinished;
     std::vector<std::thread> threads;
     std::size_t nbTasks {0};
+    std::size_t nbCoroutines {0};
     std::size_t nbThreads;
+    std::chrono::microseconds spin_duration;
+    std::atomic<std::size_t> work_epoch {0};
     bool isStop {false};
+    bool isCoroutinesHeld {false};
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -1643,18 +3837,49 @@ private:
 class [[nodiscard]] Sys final {
 friend class World;
 friend class ZerEngine;
+friend class CoroutineScheduler;
 private:
-    Sys(World& world) noexcept:
-        threadpool(world, std::thread::hardware_concurrency() - 1)
+    Sys(Profiler& new_profiler) noexcept:
+        profiler(new_profiler)
     {
         std::srand(std::time(nullptr));
     }
 
+    // Created on first use: a World ticked by an Executor, or without multithreading, never spawns its own threads.
+    [[nodiscard]] auto get_threadpool(World& world) noexcept -> ThreadPool& {
+        if (threadpool == nullptr) {
+            threadpool = std::make_unique<ThreadPool>(world, profiler, threadpool_config);
+        }
+        return *threadpool;
+    }
+
+    // Without worker (single core, or set_worker_threads(0)), the threaded sets run on the main thread.
+    [[nodiscard]] constexpr auto is_multithreaded() const noexcept -> bool {
+        return isUseMultithreading && threadpool_config.nb_workers > 0;
+    }
+
+    // No coroutine resumed on a worker runs during an upgrade.
+    void hold_worker_coroutines() noexcept {
+        if (threadpool != nullptr) {
+            threadpool->hold_coroutines();
+        }
+    }
+
+    void release_worker_coroutines() noexcept {
+        if (threadpool != nullptr) {
+            threadpool->release_coroutines();
+        }
+    }
+
 private:
     constexpr void useMultithreading(bool newVal) noexcept {
         isUseMultithreading = newVal;
     }
 
+    [[nodiscard]] constexpr auto get_threadpool_config() noexcept -> ThreadPoolConfig& {
+        return threadpool_config;
+    }
+
     constexpr void addStartSys(std::function<void(StartSystem, World&)>&& func) noexcept {
         startSystems.emplace_back(std::move(func));
     }
@@ -1695,9 +3920,38 @@ private:
         lateUnscaledFixedSystems.emplace_back(std::move(cond), std::move(funcs));
     }
 
+    template <auto... Systems>
+    void add_schedule(Schedule<Systems...>) noexcept {
+        using NewSchedule = Schedule<Systems...>;
+        if constexpr (NewSchedule::template has_phase<StartSystem>) {
+            start_schedules.emplace_back(&NewSchedule::template run<StartSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<MainSystem>) {
+            main_schedules.emplace_back(&NewSchedule::template run<MainSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<MainFixedSystem>) {
+            main_fixed_schedules.emplace_back(&NewSchedule::template run<MainFixedSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<MainUnscaledFixedSystem>) {
+            main_unscaled_fixed_schedules.emplace_back(&NewSchedule::template run<MainUnscaledFixedSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<LateSystem>) {
+            late_schedules.emplace_back(&NewSchedule::template run<LateSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<LateFixedSystem>) {
+            late_fixed_schedules.emplace_back(&NewSchedule::template run<LateFixedSystem>);
+        }
+        if constexpr (NewSchedule::template has_phase<LateUnscaledFixedSystem>) {
+            late_unscaled_fixed_schedules.emplace_back(&NewSchedule::template run<LateUnscaledFixedSystem>);
+        }
+    }
+
     void add_callback_system(void(*const callback)(CallbackSystem, World&, const Entity), const Entity entity) noexcept {
-        std::unique_lock<std::mutex> lock(mtx);
-        callback_systems.emplace_back(callback, entity);
+        callback_buffers.emplace_back(callback, entity);
+    }
+
+    void add_independent_callback_system(void(*const callback)(CallbackSystem, World&, const Entity), const Entity entity) noexcept {
+        independent_callback_buffers.emplace_back(callback, entity);
     }
 
     void add_on_add_component_hooks(const Type new_type, std::initializer_list<std::function<void(OnAddComponentHook, World&, const Entity)>>&& callback) noexcept {
@@ -1749,15 +4003,26 @@ private:
     }
 
     void start(World& world) const noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::start");
         for (const auto& func: startSystems) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "StartSystem", Profiler::system_address(func));
             func(start_system, world);
         }
+        run_schedules(world, start_schedules, "StartSchedule");
+    }
+
+    void run_schedules(World& world, const std::vector<void(*)(World&)>& schedules, [[maybe_unused]] const char* const name) const noexcept {
+        for (const auto schedule_phase: schedules) {
+            ZERENGINE_PROFILE_SCOPE(profiler, name, Profiler::system_address(schedule_phase));
+            schedule_phase(world);
+        }
     }
 
     void run_main_set_rec(World& world, const MainSet& set) noexcept {
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
                 for (const auto& function: set.tasks) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "MainSystem", Profiler::system_address(function));
                     function({}, world);
                 }
             }
@@ -1770,12 +4035,13 @@ private:
     void run_threaded_set_rec(World& world, const ThreadedSet& set) noexcept {
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
-                if (!isUseMultithreading) {
+                if (!is_multithreaded()) {
                     for (const auto& function: set.tasks) {
+                        ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedSystem", Profiler::system_address(function));
                         function({}, world);
                     }
                 } else {
-                    threadpool.addTasks(set.tasks);
+                    get_threadpool(world).addTasks(set.tasks);
                 }
             }
             for (const auto& sub_set: set.subSets) {
@@ -1785,34 +4051,40 @@ private:
     }
 
     void run(World& world) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::run");
         for (const auto& sub_set: main_set_systems) {
             run_main_set_rec(world, sub_set);
         }
+        run_schedules(world, main_schedules, "MainSchedule");
 
         for (const auto& subSet: threaded_set_systems) {
             run_threaded_set_rec(world, subSet);
         }
 
-        if (isUseMultithreading) {
-            threadpool.run();
-            threadpool.wait();
+        if (is_multithreaded()) {
+            get_threadpool(world).run();
+            get_threadpool(world).wait();
         }
     }
 
     void runLate(World& world) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::runLate");
         for (const auto& lateFunc: lateSystems) {
             if (lateFunc.first == nullptr || lateFunc.first(world)) {
                 for (const auto& lateRow: lateFunc.second) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "LateSystem", Profiler::system_address(lateRow));
                     lateRow(late_system, world);
                 }
             }
         }
+        run_schedules(world, late_schedules, "LateSchedule");
     }
 
     void run_main_fixed_set_rec(World& world, const MainFixedSet& set) noexcept {
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
                 for (const auto& function: set.tasks) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "MainFixedSystem", Profiler::system_address(function));
                     function({}, world);
                 }
             }
@@ -1825,12 +4097,13 @@ private:
     void runThreadedFixedSetRec(World& world, const ThreadedFixedSet& set) noexcept {
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
-                if (!isUseMultithreading) {
+                if (!is_multithreaded()) {
                     for (auto& func: set.tasks) {
+                        ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedFixedSystem", Profiler::system_address(func));
                         func({}, world);
                     }
                 } else {
-                    threadpool.addFixedTasks(set.tasks);
+                    get_threadpool(world).addFixedTasks(set.tasks);
                 }
             }
             for (const auto& subSet: set.subSets) {
@@ -1840,37 +4113,42 @@ private:
     }
 
     void runFixed(World& world) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::runFixed");
         for (const auto& sub_set: main_fixed_set_systems) {
             run_main_fixed_set_rec(world, sub_set);
         }
+        run_schedules(world, main_fixed_schedules, "MainFixedSchedule");
 
         for (const auto& subSet: threadedFixedSystems) {
             runThreadedFixedSetRec(world, subSet);
         }
 
-        if (isUseMultithreading) {
-            threadpool.fixedRun();
-            threadpool.fixedWait();
+        if (is_multithreaded()) {
+            get_threadpool(world).fixedRun();
+            get_threadpool(world).fixedWait();
         }
 
         for (const auto& lateFunc: lateFixedSystems) {
             if (lateFunc.first == nullptr || lateFunc.first(world)) {
                 for (const auto& lateRow: lateFunc.second) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "LateFixedSystem", Profiler::system_address(lateRow));
                     lateRow({}, world);
                 }
             }
         }
+        run_schedules(world, late_fixed_schedules, "LateFixedSchedule");
     }
 
     void runThreadedUnscaledFixedSetRec(World& world, const ThreadedUnscaledFixedSet& set) noexcept {
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
-                if (!isUseMultithreading) {
+                if (!is_multithreaded()) {
                     for (auto& func: set.tasks) {
+                        ZERENGINE_PROFILE_SCOPE(profiler, "ThreadedUnscaledFixedSystem", Profiler::system_address(func));
                         func({}, world);
                     }
                 } else {
-                    threadpool.addUnscaledFixedTasks(set.tasks);
+                    get_threadpool(world).addUnscaledFixedTasks(set.tasks);
                 }
             }
             for (const auto& subSet: set.subSets) {
@@ -1883,6 +4161,7 @@ private:
         if (set.condition == nullptr || set.condition(world)) {
             if (!set.tasks.empty()) {
                 for (const auto& function: set.tasks) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "MainUnscaledFixedSystem", Profiler::system_address(function));
                     function({}, world);
                 }
             }
@@ -1893,33 +4172,55 @@ private:
     }
 
     void runUnscaledFixed(World& world) noexcept {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::runUnscaledFixed");
         for (const auto& subSet: main_unscaled_fixed_set_systems) {
             run_main_unscaled_fixed_set_rec(world, subSet);
         }
+        run_schedules(world, main_unscaled_fixed_schedules, "MainUnscaledFixedSchedule");
 
         for (const auto& subSet: threaded_unscaled_fixed_set_systems) {
             runThreadedUnscaledFixedSetRec(world, subSet);
         }
 
-        if (isUseMultithreading) {
-            threadpool.unscaledFixedRun();
-            threadpool.unscaledFixedWait();
+        if (is_multithreaded()) {
+            get_threadpool(world).unscaledFixedRun();
+            get_threadpool(world).unscaledFixedWait();
         }
 
         for (const auto& lateFunc: lateUnscaledFixedSystems) {
             if (lateFunc.first == nullptr || lateFunc.first(world)) {
                 for (const auto& lateRow: lateFunc.second) {
+                    ZERENGINE_PROFILE_SCOPE(profiler, "LateUnscaledFixedSystem", Profiler::system_address(lateRow));
                     lateRow(late_unscaled_fixed_system, world);
                 }
             }
         }
+        run_schedules(world, late_unscaled_fixed_schedules, "LateUnscaledFixedSchedule");
     }
 
+    // Callbacks sent by the callbacks themselves run at the next call.
     void run_callbacks(World& world) {
+        ZERENGINE_PROFILE_SCOPE(profiler, "Sys::run_callbacks");
+        callback_buffers.drain(callback_systems);
         for (const auto& [callback, entity]: callback_systems) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "CallbackSystem", Profiler::system_address(callback));
             callback({}, world, entity);
         }
         callback_systems.clear();
+
+        independent_callback_buffers.drain(callback_systems);
+        if (is_multithreaded() && callback_systems.size() > ThreadPool::CALLBACK_BATCH_SIZE) {
+            get_threadpool(world).addCallbacks(std::move(callback_systems));
+            get_threadpool(world).callbacksRun();
+            get_threadpool(world).callbacksWait();
+            callback_systems.clear();
+        } else {
+            for (const auto& [callback, entity]: callback_systems) {
+                ZERENGINE_PROFILE_SCOPE(profiler, "CallbackSystem", Profiler::system_address(callback));
+                callback({}, world, entity);
+            }
+            callback_systems.clear();
+        }
     }
 
 private:
@@ -1933,7 +4234,16 @@ private:
     std::vector<std::pair<std::function<bool(World&)>, std::vector<std::function<void(LateSystem, World&)>>>> lateSystems;
     std::vector<std::pair<std::function<bool(World&)>, std::vector<std::function<void(LateFixedSystem, World&)>>>> lateFixedSystems;
     std::vector<std::pair<std::function<bool(World&)>, std::vector<std::function<void(LateUnscaledFixedSystem, World&)>>>> lateUnscaledFixedSystems;
+    ThreadBuffers<std::pair<void(*)(CallbackSystem, World&, const Entity), Entity>> callback_buffers;
+    ThreadBuffers<std::pair<void(*)(CallbackSystem, World&, const Entity), Entity>> independent_callback_buffers;
     std::vector<std::pair<void(*)(CallbackSystem, World&, const Entity), Entity>> callback_systems;
+    std::vector<void(*)(World&)> start_schedules;
+    std::vector<void(*)(World&)> main_schedules;
+    std::vector<void(*)(World&)> main_fixed_schedules;
+    std::vector<void(*)(World&)> main_unscaled_fixed_schedules;
+    std::vector<void(*)(World&)> late_schedules;
+    std::vector<void(*)(World&)> late_fixed_schedules;
+    std::vector<void(*)(World&)> late_unscaled_fixed_schedules;
 
 public:
     std::unordered_map<Type, std::vector<std::function<void(OnAddComponentHook, World&, const Entity)>>> on_add_component_hooks;
@@ -1942,14 +4252,16 @@ public:
     std::unordered_map<Type, std::vector<std::function<void(OnDeleteEntityHook, World&, const Entity)>>> on_delete_entity_hooks;
 
 private:
-    ThreadPool threadpool;
+    Profiler& profiler;
+    std::unique_ptr<ThreadPool> threadpool;
+    ThreadPoolConfig threadpool_config;
     bool isUseMultithreading {true};
-    std::mutex mtx;
 };
 
 void LateUpgrade::upgrade_hook_add_component(World& world, Sys& sys, const Entity entity, const Type type) noexcept {
     if (auto hooks_it = sys.on_add_component_hooks.find(type); hooks_it != sys.on_add_component_hooks.end()) {
         for (const auto& callback: hooks_it->second) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "OnAddComponentHook", Profiler::system_address(callback));
             callback({}, world, entity);
         }
     }
@@ -1958,6 +4270,7 @@ void LateUpgrade::upgrade_hook_add_component(World& world, Sys& sys, const Entit
 void LateUpgrade::upgrade_hook_create_entity_with_component(World& world, Sys& sys, const Entity entity, const Type type) noexcept {
     if (auto hooks_it = sys.on_create_entity_hooks.find(type); hooks_it != sys.on_create_entity_hooks.end()) {
         for (const auto& callback: hooks_it->second) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "OnCreateEntityHook", Profiler::system_address(callback));
             callback({}, world, entity);
         }
     }
@@ -1966,6 +4279,7 @@ void LateUpgrade::upgrade_hook_create_entity_with_component(World& world, Sys& s
 void LateUpgrade::upgrade_hook_remove_component(World& world, Sys& sys, const Entity entity, const Type type) noexcept {
     if (auto hooks_it = sys.on_remove_component_hooks.find(type); hooks_it != sys.on_remove_component_hooks.end()) {
         for (const auto& callback: hooks_it->second) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "OnRemoveComponentHook", Profiler::system_address(callback));
             callback({}, world, entity);
         }
     }
@@ -1974,18 +4288,346 @@ void LateUpgrade::upgrade_hook_remove_component(World& world, Sys& sys, const En
 void LateUpgrade::upgrade_hook_delete_entity_with_component(World& world, Sys& sys, const Entity entity, const Type type) noexcept {
     if (auto hooks_it = sys.on_delete_entity_hooks.find(type); hooks_it != sys.on_delete_entity_hooks.end()) {
         for (const auto& callback: hooks_it->second) {
+            ZERENGINE_PROFILE_SCOPE(profiler, "OnDeleteEntityHook", Profiler::system_address(callback));
             callback({}, world, entity);
         }
     }
 }
 
+void LateUpgrade::upgrade_hook_commit_scene(World& world, const Registry& registry, Sys& sys, const std::vector<Entity>& new_entities) noexcept {
+    if (sys.on_create_entity_hooks.empty()) {
+        return;
+    }
+    for (const auto new_entity: new_entities) {
+        for (const auto type: registry.get_all_components_types(new_entity)) {
+            upgrade_hook_create_entity_with_component(world, sys, new_entity, type);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+class CoroutineScheduler;
+
+// Gameplay spanning several frames, started by World::start_coroutine() from any system or callback. It runs until its
+// first co_await, then is resumed by the World:
+// - co_await next_frame: on the main thread, at the start of the next frame (before the MainSets).
+// - co_await fixed_step: on the main thread, before the ThreadedFixedSets/MainFixedSets of the next fixed step.
+// - co_await wait_seconds(t): like next_frame, once t seconds of scaled time are elapsed.
+// - co_await worker_thread: on a worker of the ThreadPool, while the frames go on, but never during an upgrade. Until its
+//   next co_await, the coroutine may only touch the data it owns, not the World. Without worker, it goes on at once on the
+//   current thread.
+class [[nodiscard]] Coroutine final {
+friend class CoroutineScheduler;
+public:
+    struct promise_type final {
+        [[nodiscard]] auto get_return_object() noexcept -> Coroutine {
+            return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        [[nodiscard]] constexpr auto initial_suspend() const noexcept -> std::suspend_always {
+            return {};
+        }
+
+        [[nodiscard]] constexpr auto final_suspend() const noexcept -> std::suspend_never {
+            return {};
+        }
+
+        constexpr void return_void() const noexcept {
+        }
+
+        [[noreturn]] void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+
+        CoroutineScheduler* scheduler = nullptr;
+    };
+
+public:
+    Coroutine(const Coroutine&) = delete;
+    auto operator=(const Coroutine&) -> Coroutine& = delete;
+
+    Coroutine(Coroutine&& other) noexcept:
+        handle(std::exchange(other.handle, nullptr)) {
+    }
+
+    auto operator=(Coroutine&&) -> Coroutine& = delete;
+
+    ~Coroutine() noexcept {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+private:
+    explicit Coroutine(const std::coroutine_handle<promise_type> new_handle) noexcept:
+        handle(new_handle) {
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Suspended coroutines of a World. Each one is in exactly one list (or in the ThreadPool), destroyed with the World.
+class [[nodiscard]] CoroutineScheduler final {
+friend class World;
+friend class ZerEngine;
+friend struct NextFrame;
+friend struct FixedStep;
+friend struct WaitSeconds;
+friend struct WorkerThread;
+private:
+    CoroutineScheduler(World& new_world, Sys& new_sys) noexcept:
+        world(new_world),
+        sys(new_sys) {
+    }
+
+    ~CoroutineScheduler() noexcept {
+        for (const auto handle: next_frame_handles) {
+            handle.destroy();
+        }
+        for (const auto handle: fixed_step_handles) {
+            handle.destroy();
+        }
+        for (const auto& [end_time, handle]: timers) {
+            handle.destroy();
+        }
+    }
+
+    void start(Coroutine&& coroutine) noexcept {
+        const auto handle = std::exchange(coroutine.handle, nullptr);
+        handle.promise().scheduler = this;
+        handle.resume();
+    }
+
+    void add_next_frame(const std::coroutine_handle<> handle) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        next_frame_handles.emplace_back(handle);
+    }
+
+    void add_fixed_step(const std::coroutine_handle<> handle) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        fixed_step_handles.emplace_back(handle);
+    }
+
+    void add_timer(const std::coroutine_handle<> handle, const float seconds) noexcept {
+        const std::unique_lock<std::mutex> lock(mtx);
+        timers.emplace_back(time + seconds, handle);
+    }
+
+    // false: no worker, the coroutine goes on at once.
+    [[nodiscard]] auto add_worker_thread(const std::coroutine_handle<> handle) noexcept -> bool {
+        if (!sys.is_multithreaded()) {
+            return false;
+        }
+        sys.get_threadpool(world).addCoroutine(handle);
+        return true;
+    }
+
+    void resume_frame(const float delta) noexcept {
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            time += delta;
+            std::swap(resumed_handles, next_frame_handles);
+            std::erase_if(timers, [&](const auto& timer) {
+                if (timer.first <= time) {
+                    resumed_handles.emplace_back(timer.second);
+                    return true;
+                }
+                return false;
+            });
+        }
+        resume(resumed_handles);
+    }
+
+    void resume_fixed_step() noexcept {
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            std::swap(resumed_handles, fixed_step_handles);
+        }
+        resume(resumed_handles);
+    }
+
+    // The resumed coroutines suspend again into the other lists: resumed_handles keeps its capacity for the next frame.
+    static void resume(std::vector<std::coroutine_handle<>>& handles) noexcept {
+        for (const auto handle: handles) {
+            handle.resume();
+        }
+        handles.clear();
+    }
+
+private:
+    World& world;
+    Sys& sys;
+    std::mutex mtx;
+    double time = 0;
+    std::vector<std::coroutine_handle<>> next_frame_handles;
+    std::vector<std::coroutine_handle<>> fixed_step_handles;
+    std::vector<std::pair<double, std::coroutine_handle<>>> timers;
+    std::vector<std::coroutine_handle<>> resumed_handles;
+};
+
+struct [[nodiscard]] NextFrame final {
+    [[nodiscard]] constexpr auto await_ready() const noexcept -> bool {
+        return false;
+    }
+
+    void await_suspend(const std::coroutine_handle<Coroutine::promise_type> handle) const noexcept {
+        handle.promise().scheduler->add_next_frame(handle);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+};
+
+struct [[nodiscard]] FixedStep final {
+    [[nodiscard]] constexpr auto await_ready() const noexcept -> bool {
+        return false;
+    }
+
+    void await_suspend(const std::coroutine_handle<Coroutine::promise_type> handle) const noexcept {
+        handle.promise().scheduler->add_fixed_step(handle);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+};
+
+struct [[nodiscard]] WaitSeconds final {
+    [[nodiscard]] constexpr auto await_ready() const noexcept -> bool {
+        return false;
+    }
+
+    void await_suspend(const std::coroutine_handle<Coroutine::promise_type> handle) const noexcept {
+        handle.promise().scheduler->add_timer(handle, seconds);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+
+    float seconds;
+};
+
+struct [[nodiscard]] WorkerThread final {
+    [[nodiscard]] constexpr auto await_ready() const noexcept -> bool {
+        return false;
+    }
+
+    [[nodiscard]] auto await_suspend(const std::coroutine_handle<Coroutine::promise_type> handle) const noexcept -> bool {
+        return handle.promise().scheduler->add_worker_thread(handle);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+};
+
+constexpr inline NextFrame next_frame;
+constexpr inline FixedStep fixed_step;
+constexpr inline WorkerThread worker_thread;
+
+[[nodiscard]] constexpr auto wait_seconds(const float seconds) noexcept -> WaitSeconds {
+    return WaitSeconds {seconds};
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 
+enum class FramePacing: uint8_t {
+    UNLIMITED,        // Frames run back to back (default).
+    TARGET_TICK_RATE, // Frames start every 1 / tick_rate seconds.
+    EVENT_DRIVEN,     // The main thread is parked until the next fixed step is due or World::wake_up() is called.
+};
+
+// Waits between two frames without burning a core: sleeps (interruptible by wake_up) until SPIN_MARGIN before
+// the deadline, then spins the rest so that the frame start jitter stays in the microseconds.
+class [[nodiscard]] FramePacer final {
+friend class World;
+friend class ZerEngine;
+friend class Executor;
+private:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    FramePacer() noexcept = default;
+
+    constexpr void set_pacing(const FramePacing new_pacing, const float tick_rate = 0) noexcept {
+        pacing = new_pacing;
+        if (tick_rate > 0) {
+            frame_duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tick_rate));
+        }
+        next_frame = Clock::now();
+    }
+
+    void wait_next_frame(const float seconds_until_fixed_step) noexcept {
+        switch (pacing) {
+            case FramePacing::UNLIMITED:
+                return;
+            case FramePacing::TARGET_TICK_RATE: {
+                const auto now = Clock::now();
+                next_frame += frame_duration;
+                // Too late by more than a frame: restarts from now instead of running frames back to back to catch up.
+                if (next_frame + frame_duration < now) {
+                    next_frame = now;
+                }
+                wait_until(next_frame);
+                return;
+            }
+            case FramePacing::EVENT_DRIVEN:
+                if (seconds_until_fixed_step > 0) {
+                    wait_until(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds_until_fixed_step)));
+                }
+                return;
+        }
+    }
+
+    void wait_until(const Clock::time_point deadline) noexcept {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait_until(lock, deadline - SPIN_MARGIN, [this] { return woken_up.load(std::memory_order_relaxed); });
+            if (woken_up.exchange(false, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // A wake_up() during the spin ends the wait too, instead of cutting the next one short.
+        while (Clock::now() < deadline) {
+            if (woken_up.exchange(false, std::memory_order_relaxed)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void wake_up() noexcept {
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            woken_up.store(true, std::memory_order_relaxed);
+        }
+        cv.notify_one();
+    }
+
+private:
+    static constexpr auto SPIN_MARGIN = std::chrono::microseconds(1500);
+    FramePacing pacing = FramePacing::UNLIMITED;
+    Clock::duration frame_duration {};
+    Clock::time_point next_frame {};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<bool> woken_up = false;
+};
+
+// What happens to the fixed steps over Time's max_fixed_steps after a slow frame.
+enum class FixedStepOverflow: uint8_t {
+    DROP,  // The late time is lost: the simulation slows down but recovers immediately.
+    SMEAR, // The late time is kept, up to max_fixed_steps steps, and caught up max_fixed_steps at a time over the next frames.
+};
+
+// Monotonic time source, in nanoseconds since an arbitrary epoch (see ZerEngine::set_clock).
+using TimeSource = std::function<std::chrono::nanoseconds()>;
+
 class [[nodiscard]] Time final: public IResource {
 friend class ZerEngine;
 public:
     Time(const float& newFixedTimeStep = 0.02f) noexcept:
-        t2(std::chrono::high_resolution_clock::now()),
+        t2(now()),
         totalTime(std::chrono::high_resolution_clock::now()),
         fixedTimeStep(newFixedTimeStep) {
     }
@@ -1995,20 +4637,56 @@ private:
         fixedTimeStep = newFixedTimeStep;
     }
 
+    constexpr void set_max_fixed_steps(const unsigned int newMaxFixedSteps, const FixedStepOverflow newFixedStepOverflow) noexcept {
+        maxFixedSteps = newMaxFixedSteps;
+        fixedStepOverflow = newFixedStepOverflow;
+    }
+
+    void set_clock(TimeSource&& newClock) noexcept {
+        clock = std::move(newClock);
+        t2 = now();
+    }
+
+    [[nodiscard]] auto now() const noexcept -> std::chrono::nanoseconds {
+        if (clock) {
+            return clock();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+    }
+
     void update() noexcept {
-        auto t1 = std::chrono::high_resolution_clock::now();
-        dt = std::chrono::duration_cast<std::chrono::duration<float>>(t1 - t2).count();
+        auto t1 = now();
+        advance(std::chrono::duration_cast<std::chrono::duration<float>>(t1 - t2).count());
         t2 = t1;
+    }
+
+    // Externally driven frame: the clock is only read so that a later update() does not see the whole pause as one frame.
+    void update(const float delta) noexcept {
+        advance(delta);
+        t2 = now();
+    }
+
+    void advance(const float delta) noexcept {
+        dt = delta;
         timeScale = newTimeScale;
         #ifdef DISPLAY_FPS
             frame_counter();
         #endif
         timeStepBuffer += dt;
         isTimeStepFrame = false;
+        nbFixedSteps = 0;
         if (timeStepBuffer >= fixedTimeStep) {
             isTimeStepFrame = true;
             nbFixedSteps = std::floor(timeStepBuffer / fixedTimeStep);
             timeStepBuffer -= fixedTimeStep * nbFixedSteps;
+            // Caps the catch-up after a hitch, otherwise each slow frame schedules more fixed steps than the last one.
+            if (maxFixedSteps != 0 && nbFixedSteps > maxFixedSteps) {
+                // The carry is capped too: frames that stay slow would pile up late time without end.
+                if (fixedStepOverflow == FixedStepOverflow::SMEAR) {
+                    timeStepBuffer = std::min(timeStepBuffer + fixedTimeStep * (nbFixedSteps - maxFixedSteps), fixedTimeStep * maxFixedSteps);
+                }
+                nbFixedSteps = maxFixedSteps;
+            }
         }
     }
 
@@ -2037,6 +4715,21 @@ public:
         return nbFixedSteps;
     }
 
+    [[nodiscard]] constexpr auto get_max_fixed_steps() const noexcept -> unsigned int {
+        return maxFixedSteps;
+    }
+
+    // Wall-clock time left before the next fixed step is due, used by FramePacing::EVENT_DRIVEN.
+    [[nodiscard]] auto seconds_until_fixed_step() const noexcept -> float {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::duration<float>>(now() - t2).count();
+        return fixedTimeStep - timeStepBuffer - elapsed;
+    }
+
+    // Progress between the last fixed step and the next one in [0, 1]: interpolate the presentation with it.
+    [[nodiscard]] constexpr auto alpha() const noexcept -> float {
+        return std::min(timeStepBuffer / fixedTimeStep, 1.0f);
+    }
+
     [[nodiscard]] constexpr auto get_time_scale() const noexcept -> float {
         return newTimeScale;
     }
@@ -2064,12 +4757,15 @@ private:
 
 private:
     double dt = 0;
-    std::chrono::high_resolution_clock::time_point t2;
+    TimeSource clock;
+    std::chrono::nanoseconds t2;
     std::chrono::high_resolution_clock::time_point totalTime;
     bool isTimeStepFrame = false;
     float fixedTimeStep;
     float timeStepBuffer = 0;
     unsigned int nbFixedSteps = 0;
+    unsigned int maxFixedSteps = 0;
+    FixedStepOverflow fixedStepOverflow = FixedStepOverflow::DROP;
 
     #ifdef DISPLAY_FPS
         float timer = 0;
@@ -2082,34 +4778,29 @@ private:
 
 class [[nodiscard]] World final {
 friend class ZerEngine;
+friend class Executor;
 private:
     World() noexcept:
-        sys(*this) {
+        lateUpgrade(profiler),
+        coroutines(*this, sys),
+        sys(profiler) {
     }
 
 public:
     [[nodiscard("La valeur de retour d'une commande Exist doit toujours etre evalue")]] auto is_entity_exists(const Entity entity) const noexcept -> bool {
-        return (reg.is_entity_exist(entity) || lateUpgrade.add_entities.contains(entity)) && !lateUpgrade.delEnts.contains(entity);
+        const std::unique_lock<std::mutex> lock(lateUpgrade.mtx);
+        return internal_is_entity_exists(entity);
     }
 
     template <typename T, typename... Ts> requires ((IsComponentConcept<T> && (IsComponentConcept<Ts> && ...)) && (!std::is_const_v<T> || (!std::is_const_v<Ts> || ...)))
     [[nodiscard("La valeur de retour d'une commande Has doit toujours etre evalue")]] auto has_components_this_frame(const Entity entity) const noexcept -> bool {
-        if (!is_entity_exists(entity)) {
+        const std::unique_lock<std::mutex> lock(lateUpgrade.mtx);
+        if (!internal_is_entity_exists(entity)) {
             return false;
         }
-        if (reg.has_components(entity, {typeid(T).hash_code()})) {
-            if constexpr (sizeof...(Ts) > 0) {
-                return has_components<Ts...>(entity);
-            }
-            return true;
-        }
-        if (auto addCompsIt = lateUpgrade.addComps.find(entity); addCompsIt != lateUpgrade.addComps.end() && addCompsIt->second.contains(typeid(T).hash_code())) {
-            if constexpr (sizeof...(Ts) > 0) {
-                return has_components<Ts...>(entity);
-            }
-            return true;
-        }
-        return false;
+        const auto location = reg.get_location(entity);
+        const auto pending = lateUpgrade.find_pending_components(entity);
+        return (internal_has_component_this_frame<T>(entity, location, pending) && ... && internal_has_component_this_frame<Ts>(entity, location, pending));
     }
 
     template <typename... Ts> requires (sizeof...(Ts) > 0 && ((IsComponentConcept<Ts> && !std::is_const_v<Ts>) && ...))
@@ -2118,32 +4809,67 @@ public:
     }
 
 private:
-    [[nodiscard]] auto internal_get_components_this_frame(const Entity entity, const Type type) noexcept -> std::optional<std::reference_wrapper<std::unique_ptr<IComponent>>> {
-        if (auto addCompsIt = lateUpgrade.addComps.find(entity); addCompsIt != lateUpgrade.addComps.end()) {
-            if (addCompsIt->second.contains(type)) {
-                return lateUpgrade.registry_messages[addCompsIt->second.at(type)].component.second;
+    // Under lateUpgrade.mtx.
+    [[nodiscard]] auto internal_is_entity_exists(const Entity entity) const noexcept -> bool {
+        if (const auto state = lateUpgrade.find_pending_state(entity)) {
+            return (state->create_message != LateUpgrade::NO_MESSAGE || reg.is_entity_exist(entity)) && !state->is_deleted;
+        }
+        return reg.is_entity_exist(entity);
+    }
+
+    template <typename T>
+    [[nodiscard]] auto internal_has_component_this_frame(const Entity entity, const EntityLocation* const location, const std::vector<std::pair<Type, LateUpgrade::RegistryMessageIndex>>* const pending) const noexcept -> bool {
+        if (pending != nullptr && LateUpgrade::find_pending_component(*pending, typeid(T).hash_code()) != pending->end()) {
+            return true;
+        }
+        if (location == nullptr) {
+            return false;
+        }
+        if constexpr (is_sparse_component_v<T>) {
+            const auto sparse_set = reg.get_sparse_set(typeid(T).hash_code());
+            return sparse_set != nullptr && sparse_set->contains(entity);
+        } else {
+            return location->archetype->types.contains(typeid(T).hash_code());
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] auto internal_get_component_this_frame(const Entity entity, const EntityLocation* const location, const std::vector<std::pair<Type, LateUpgrade::RegistryMessageIndex>>* const pending) noexcept -> T* {
+        if (pending != nullptr) {
+            if (auto pending_it = LateUpgrade::find_pending_component(*pending, typeid(T).hash_code()); pending_it != pending->end()) {
+                return static_cast<T*>(lateUpgrade.registry_messages[pending_it->second].component.second.get());
             }
         }
-        if (auto opt = reg.get(entity, type)) {
-            return opt.value();
+        if constexpr (is_sparse_component_v<T>) {
+            if (auto sparse_set = reg.get_sparse_set(typeid(T).hash_code()); location != nullptr && sparse_set != nullptr && sparse_set->contains(entity)) {
+                return static_cast<T*>(sparse_set->get(entity));
+            }
+        } else if (location != nullptr) {
+            if (auto column = location->archetype->get_column(typeid(T).hash_code())) {
+                return static_cast<T*>((*column)[location->row].get());
+            }
         }
-        return std::nullopt;
+        return nullptr;
     }
 
 public:
+    // L'emplacement de l'entite et ses composants en attente ne sont resolus qu'une seule fois pour tout Ts...
     template <typename T, typename... Ts> requires (IsComponentConcept<T> && IsNotEmptyConcept<T> && IsNotSameConcept<T, Ts...>)
     [[nodiscard("La valeur de retour d'une commande Get doit toujours etre recupere")]] auto get_components_this_frame(const Entity entity) noexcept -> std::optional<std::tuple<T&, Ts&...>> {
-        if (auto opt_component = internal_get_components_this_frame(entity, typeid(T).hash_code())) {
-            auto& component = *static_cast<T*>(opt_component.value().get().get());
-            if constexpr (sizeof...(Ts) > 0) {
-                if (auto othOpt = get_components_this_frame<Ts...>(entity)) {
-                    return std::tuple_cat(std::forward_as_tuple(component), othOpt.value());
-                }
-            } else {
-                return std::forward_as_tuple(component);
-            }
+        const std::unique_lock<std::mutex> lock(lateUpgrade.mtx);
+        const auto location = reg.get_location(entity);
+        const auto pending = lateUpgrade.find_pending_components(entity);
+        if (location == nullptr && pending == nullptr) {
+            return std::nullopt;
         }
-        return std::nullopt;
+
+        const std::tuple<T*, Ts*...> components(internal_get_component_this_frame<T>(entity, location, pending), internal_get_component_this_frame<Ts>(entity, location, pending)...);
+        return std::apply([](auto*... component) -> std::optional<std::tuple<T&, Ts&...>> {
+            if (((component == nullptr) || ...)) {
+                return std::nullopt;
+            }
+            return std::tuple<T&, Ts&...>(*component...);
+        }, components);
     }
 
     template <typename... Ts> requires (sizeof...(Ts) > 0 && ((IsComponentConcept<Ts> && IsNotEmptyConcept<Ts>) && ...) && IsNotSameConcept<Ts...>)
@@ -2158,14 +4884,31 @@ public:
 
     template <typename... Ts> requires ((sizeof...(Ts) > 0) && (IsResourceConcept<Ts> && ...))
     [[nodiscard("La valeur de retour d'une commande Resource doit toujours etre recupere")]] auto resource() noexcept -> std::tuple<Ts&...> {
+        if constexpr (ZERENGINE_HAS_CHECKS) {
+            (check_resource<Ts>(), ...);
+        }
         return std::forward_as_tuple(*static_cast<Ts*>(res.get(typeid(Ts).hash_code()).get())...);
     }
 
+private:
+    // Fatal: a missing resource has no value to return (the staging World of stream_scene() only has Time).
+    // The diagnostics of the frame are flushed before aborting.
+    template <typename T>
+    void check_resource() const noexcept {
+        if (!res.contains(typeid(T).hash_code())) {
+            ZERENGINE_DIAGNOSTIC("World::resource() - Impossible de recuperer une ressource absente de ce World: {}", typeid(T).name());
+            Diagnostics::flush();
+            std::abort();
+        }
+    }
+
+public:
+
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2177,9 +4920,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2191,9 +4934,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2205,9 +4948,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2219,9 +4962,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2233,9 +4976,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2247,9 +4990,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2261,9 +5004,9 @@ public:
 
     template <typename... Comps, typename... Filters, typename... Excludes>
     requires (
-        (IsNotEmptyConcept<Comps> && ...) &&
-        IsNotSameConcept<Comps..., Filters..., Excludes...> &&
-        (IsComponentConcept<Comps> && ...) &&
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
         (IsComponentConcept<Filters> && ...) &&
         (IsComponentConcept<Excludes> && ...) &&
         !(std::is_const_v<Filters> || ...) &&
@@ -2273,6 +5016,159 @@ public:
         return reg.query<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(Excludes).hash_code()...});
     }
 
+    // Without building a Query: the archetypes are matched in place and nothing is allocated.
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto count(With<Filters...> = {}, Without<Excludes...> = {}) noexcept -> std::size_t {
+        return reg.count<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto count(Without<Excludes...>, With<Filters...> = {}) noexcept -> std::size_t {
+        return reg.count<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    // The first row found, in no particular order.
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto first(With<Filters...> = {}, Without<Excludes...> = {}) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        return reg.first<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto first(Without<Excludes...>, With<Filters...> = {}) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        return reg.first<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    // The row of the only entity matching (a player, a camera), std::nullopt when there are none or several.
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto single(With<Filters...> = {}, Without<Excludes...> = {}) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        return reg.single<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    template <typename... Comps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto single(Without<Excludes...>, With<Filters...> = {}) noexcept -> std::optional<std::tuple<const Entity, typename QueryTerm<Comps>::reference...>> {
+        return reg.single<Comps...>({typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...});
+    }
+
+    template <typename... Comps, typename... ParentComps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        (IsNotEmptyConcept<ParentComps> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        IsNotSameConcept<ParentComps...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<ParentComps> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto query(WithParent<ParentComps...>, With<Filters...> = {}, Without<Excludes...> = {}) noexcept {
+        return reg.join_parents<ParentComps...>(reg.query<Comps...>({typeid(Parent).hash_code(), typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...}));
+    }
+
+    template <typename... Comps, typename... ParentComps, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        (IsNotEmptyConcept<ParentComps> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        IsNotSameConcept<ParentComps...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        (IsComponentConcept<ParentComps> && ...) &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto query(WithParent<ParentComps...>, Without<Excludes...>, With<Filters...> = {}) noexcept {
+        return reg.join_parents<ParentComps...>(reg.query<Comps...>({typeid(Parent).hash_code(), typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...}));
+    }
+
+    template <typename... Comps, auto Key, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        IsComponentConcept<order_component_t<Key>> &&
+        !is_sparse_component_v<order_component_t<Key>> &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto query(OrderBy<Key>, With<Filters...> = {}, Without<Excludes...> = {}) noexcept {
+        return reg.order_rows<Key>(reg.query<Comps...>({typeid(order_component_t<Key>).hash_code(), typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...}));
+    }
+
+    template <typename... Comps, auto Key, typename... Filters, typename... Excludes>
+    requires (
+        (IsNotEmptyConcept<query_component_t<Comps>> && ...) &&
+        IsNotSameConcept<query_component_t<Comps>..., Filters..., Excludes...> &&
+        (IsComponentConcept<query_component_t<Comps>> && ...) &&
+        IsComponentConcept<order_component_t<Key>> &&
+        !is_sparse_component_v<order_component_t<Key>> &&
+        (IsComponentConcept<Filters> && ...) &&
+        (IsComponentConcept<Excludes> && ...) &&
+        !(std::is_const_v<Filters> || ...) &&
+        !(std::is_const_v<Excludes> || ...)
+    )
+    [[nodiscard]] auto query(OrderBy<Key>, Without<Excludes...>, With<Filters...> = {}) noexcept {
+        return reg.order_rows<Key>(reg.query<Comps...>({typeid(order_component_t<Key>).hash_code(), typeid(Comps).hash_code()..., typeid(Filters).hash_code()...}, {typeid(IsInactive).hash_code(), typeid(Excludes).hash_code()...}));
+    }
+
 public:
     template <typename... Components> requires ((IsComponentConcept<Components> && ...) && IsNotSameConcept<Components...>)
     auto create_entity(Components&&... components) noexcept -> Entity {
@@ -2281,10 +5177,8 @@ public:
         (lateUpgrade.add_components(
             reg,
             entity_token,
-            {
-                typeid(Components).hash_code(),
-                std::is_empty_v<Components> ? nullptr : std::make_unique<Components>(std::move(components))
-            },
+            make_component<Components>(std::move(components)),
+            get_component_storage<Components>(),
             typeid(Components).name()
         ), ...);
         return entity_token;
@@ -2296,14 +5190,14 @@ public:
             (lateUpgrade.add_components(
                 reg,
                 entity,
-                {
-                    typeid(Components).hash_code(),
-                    std::is_empty_v<Components> ? nullptr : std::make_unique<Components>(std::move(components))
-                },
+                make_component<Components>(std::move(components)),
+                get_component_storage<Components>(),
                 typeid(Components).name()
             ), ...);
-        } else if (!lateUpgrade.delEnts.contains(entity)) {
-            (std::println("World::add_components(): Impossible d'ajouter sur une entitée qui n'existe pas [Entity: {}], [type: {}]", entity, typeid(Components).name()), ...);
+        } else if (!lateUpgrade.is_deleted_this_frame(entity)) {
+            for ([[maybe_unused]] const auto component_name: {typeid(Components).name()...}) {
+                ZERENGINE_DIAGNOSTIC("World::add_components(): Impossible d'ajouter sur une entitée qui n'existe pas [Entity: {}], [type: {}]", entity, component_name);
+            }
         }
     }
 
@@ -2311,16 +5205,18 @@ public:
     void remove_components(const Entity entity) noexcept {
         if (is_entity_exists(entity)) {
             lateUpgrade.remove_components(reg, entity, {{typeid(Components).name(), typeid(Components).hash_code()}...});
-        } else if (!lateUpgrade.delEnts.contains(entity)) {
-            (std::println("World::remove_components(): Impossible de supprimer un composant qui n'existe pas - [Entity: {}], [type: {}]", entity, typeid(Components).name()), ...);
+        } else if (!lateUpgrade.is_deleted_this_frame(entity)) {
+            for ([[maybe_unused]] const auto component_name: {typeid(Components).name()...}) {
+                ZERENGINE_DIAGNOSTIC("World::remove_components(): Impossible de supprimer un composant qui n'existe pas - [Entity: {}], [type: {}]", entity, component_name);
+            }
         }
     }
 
     void delete_entity(const Entity entity) noexcept {
         if (is_entity_exists(entity)) {
             lateUpgrade.delete_entity(reg, entity);
-        } else if (!lateUpgrade.delEnts.contains(entity)) {
-            std::println("World::delete_entity(): Impossible de supprimer une entitée qui n'existe pas - [Entity: {}]", entity);
+        } else if (!lateUpgrade.is_deleted_this_frame(entity)) {
+            ZERENGINE_DIAGNOSTIC("World::delete_entity(): Impossible de supprimer une entitée qui n'existe pas - [Entity: {}]", entity);
         }
     }
 
@@ -2330,6 +5226,43 @@ public:
         }
     }
 
+    // Independent callbacks run after the others, in parallel batches on the thread pool: they must not touch the same data.
+    constexpr void use_callback(IndependentCallback, void(*const callback)(CallbackSystem, World&, const Entity), const Entity entity) {
+        if (callback) {
+            sys.add_independent_callback_system(callback, entity);
+        }
+    }
+
+    // Moves entity and its descendants into destination, components included, and returns its new handle there.
+    // Immediate, unlike the other commands: call it while neither World is running a frame (between two frames or Executor runs),
+    // on an entity without pending commands, whose parent has none either. No hook is called, the entity is moved rather
+    // than deleted and created. The old ids are recycled by the next upgrade of this World.
+    [[nodiscard]] auto transfer(const Entity entity, World& destination) noexcept -> std::optional<Entity> {
+        if (&destination == this) {
+            ZERENGINE_DIAGNOSTIC("World::transfer(): Impossible de transferer une entite dans son propre monde - [Entity: {}]", entity);
+            return std::nullopt;
+        }
+        if (!reg.is_entity_exist(entity)) {
+            ZERENGINE_DIAGNOSTIC("World::transfer(): Impossible de transferer une entitée qui n'existe pas - [Entity: {}]", entity);
+            return std::nullopt;
+        }
+        const auto subtree = reg.get_subtree(entity);
+        for (const auto subtree_entity: subtree) {
+            if (lateUpgrade.has_pending_commands(subtree_entity)) {
+                ZERENGINE_DIAGNOSTIC("World::transfer(): Impossible de transferer une entitée avec des commandes en attente - [Entity: {}]", subtree_entity);
+                return std::nullopt;
+            }
+        }
+        // The root leaves the Children of its parent: a pending command on the parent would apply to a stale set.
+        if (const auto opt_parent = reg.get_parent(entity); opt_parent.has_value() && lateUpgrade.has_pending_commands(opt_parent.value())) {
+            ZERENGINE_DIAGNOSTIC("World::transfer(): Impossible de transferer une entitée dont le parent a des commandes en attente - [Entity: {}], [Parent: {}]", entity, opt_parent.value());
+            return std::nullopt;
+        }
+        const auto new_entity = reg.transfer(subtree, destination.reg);
+        lateUpgrade.release_transferred_entities(subtree);
+        return new_entity;
+    }
+
     void set_active(const Entity ent) noexcept {
         lateUpgrade.set_active(ent);
     }
@@ -2339,7 +5272,16 @@ public:
     }
 
     [[nodiscard]] constexpr auto get_total_entities() const noexcept -> std::size_t {
-        return reg.entArch.size();
+        return reg.get_total_entities();
+    }
+
+    // Walks the archetype graph and the sparse sets, plus the Children rows for hierarchy_bytes: cheap enough to be sampled periodically.
+    [[nodiscard]] auto memory_stats() noexcept -> MemoryStats {
+        MemoryStats stats;
+        reg.memory_stats(stats);
+        stats.late_upgrade_bytes = lateUpgrade.memory_bytes();
+        stats.resource_bytes = res.memory_bytes();
+        return stats;
     }
 
     void add_dont_destroy_on_load(const Entity ent) noexcept {
@@ -2350,28 +5292,97 @@ public:
         lateUpgrade.load_scene(new_scene);
     }
 
+    // Builds the next scene over several frames instead of freezing one: at the end of each frame, new_scene is called
+    // with a staging World until it returns true (scene complete) or budget is spent. The staged entities are then moved
+    // into this World in one commit. From the main thread, replaces the scene being streamed if any.
+    // The stage only has a copy of Time: the other resources (events included) are read from world.
+    void stream_scene(bool(*const new_scene)(SceneStreamSystem, World&, World& stage), const std::chrono::microseconds budget = std::chrono::microseconds(2000), const SceneCommit scene_commit = SceneCommit::REPLACE) noexcept {
+        scene_stream = new_scene;
+        scene_stream_budget = budget;
+        scene_stream_commit = scene_commit;
+        scene_stage.reset(new World());
+        if (res.contains(typeid(Time).hash_code())) {
+            auto [time] = resource<const Time>();
+            scene_stage->res.emplace(std::make_unique<Time>(time));
+        }
+    }
+
+    [[nodiscard]] constexpr auto is_streaming_scene() const noexcept -> bool {
+        return scene_stream != nullptr;
+    }
+
+    // Runs the coroutine until its first co_await, from any system or callback (see Coroutine).
+    void start_coroutine(Coroutine&& coroutine) noexcept {
+        coroutines.start(std::move(coroutine));
+    }
+
     void stop_run(bool val = true) noexcept {
         isRunning = !val;
+        pacer.wake_up();
+    }
+
+    // Starts the next frame now, from any thread (network packet, input...) when the main loop is paced.
+    void wake_up() noexcept {
+        pacer.wake_up();
     }
 
     void upgrade() noexcept {
+        sys.hold_worker_coroutines();
         lateUpgrade.upgrade(*this, reg, sys);
+        sys.release_worker_coroutines();
+    }
+
+private:
+    // At least one call per frame, so that a budget shorter than a call still makes progress. The staged commands are
+    // applied after each call: their cost counts in the budget.
+    void stream_scene_slice() noexcept {
+        if (scene_stream == nullptr) {
+            return;
+        }
+        ZERENGINE_PROFILE_SCOPE(profiler, "SceneStreamSystem", Profiler::system_address(scene_stream));
+        const auto deadline = std::chrono::steady_clock::now() + scene_stream_budget;
+        bool is_complete = false;
+        do {
+            is_complete = scene_stream({}, *this, *scene_stage);
+            scene_stage->upgrade();
+        } while (!is_complete && std::chrono::steady_clock::now() < deadline);
+
+        if (is_complete) {
+            lateUpgrade.commit_scene(*this, reg, sys, scene_stage->reg, scene_stream_commit);
+            scene_stream = nullptr;
+            scene_stage.reset();
+        }
+    }
+
+public:
+    // Records the next nb_frames frames and writes them as a chrome://tracing JSON file (requires ZERENGINE_PROFILER).
+    void capture_profile(const std::size_t nb_frames, const std::string& path) noexcept {
+        profiler.capture(nb_frames, path);
     }
 
 private:
     TypeMap res;
     Registry reg;
+    Profiler profiler;
     LateUpgrade lateUpgrade;
+    // Destroyed after sys: the workers are joined before the suspended coroutines are destroyed.
+    CoroutineScheduler coroutines;
     Sys sys;
-    bool isRunning;
+    FramePacer pacer;
+    bool(*scene_stream)(SceneStreamSystem, World&, World&) = nullptr;
+    std::unique_ptr<World> scene_stage;
+    std::chrono::microseconds scene_stream_budget {};
+    SceneCommit scene_stream_commit = SceneCommit::REPLACE;
+    bool isRunning = false;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
 
 class [[nodiscard]] ZerEngine final {
+friend class Executor;
 public:
     ZerEngine() noexcept {
-        world.res.emplace(typeid(Time).hash_code(), std::make_unique<Time>(0.02f));
+        world.res.emplace(std::make_unique<Time>(0.02f));
     }
 
     [[nodiscard]] constexpr auto use_multithreading(bool newVal) noexcept -> ZerEngine& {
@@ -2379,15 +5390,63 @@ public:
         return *this;
     }
 
+    // 0 runs the threaded sets on the main thread. Default: ThreadPoolConfig::default_nb_workers().
+    [[nodiscard]] auto set_worker_threads(std::size_t nb_workers) noexcept -> ZerEngine& {
+        world.sys.get_threadpool_config().nb_workers = nb_workers;
+        return *this;
+    }
+
+    // Worker i is pinned to the CPUs listed in worker_cpus[i % worker_cpus.size()]. Linux only, ignored elsewhere.
+    [[nodiscard]] auto set_worker_affinity(std::vector<std::vector<std::size_t>> worker_cpus) noexcept -> ZerEngine& {
+        world.sys.get_threadpool_config().worker_cpus = std::move(worker_cpus);
+        return *this;
+    }
+
+    // Idle workers spin that long on the next set before sleeping: lower latency per set against a busy core. 0 sleeps at once.
+    [[nodiscard]] auto set_worker_spin_duration(std::chrono::microseconds spin_duration) noexcept -> ZerEngine& {
+        world.sys.get_threadpool_config().spin_duration = spin_duration;
+        return *this;
+    }
+
     [[nodiscard]] constexpr auto set_fixed_time_step(float newFixedTimeStep) noexcept -> ZerEngine& {
         auto [time] = world.resource<Time>();
         time.set_fixed_time_step(newFixedTimeStep);
         return *this;
     }
 
+    // 0 (default) runs every fixed step due, whatever the frame duration.
+    [[nodiscard]] constexpr auto set_max_fixed_steps(unsigned int newMaxFixedSteps, FixedStepOverflow newFixedStepOverflow = FixedStepOverflow::DROP) noexcept -> ZerEngine& {
+        auto [time] = world.resource<Time>();
+        time.set_max_fixed_steps(newMaxFixedSteps, newFixedStepOverflow);
+        return *this;
+    }
+
+    // Headless servers: frames start every 1 / tick_rate seconds instead of back to back.
+    [[nodiscard]] auto set_target_tick_rate(float tick_rate) noexcept -> ZerEngine& {
+        world.pacer.set_pacing(FramePacing::TARGET_TICK_RATE, tick_rate);
+        return *this;
+    }
+
+    // Parks the main thread until the next fixed step is due or world.wake_up() is called.
+    [[nodiscard]] auto use_event_driven_loop(bool newVal = true) noexcept -> ZerEngine& {
+        world.pacer.set_pacing(newVal ? FramePacing::EVENT_DRIVEN : FramePacing::UNLIMITED);
+        return *this;
+    }
+
     template <typename T, typename... Args> requires (IsResourceConcept<T>)
     [[nodiscard]] auto add_resource(Args&&... args) noexcept -> ZerEngine& {
-        world.res.emplace(typeid(T).hash_code(), std::make_unique<T>(std::forward<Args>(args)...));
+        world.res.emplace(std::make_unique<T>(std::forward<Args>(args)...));
+        return *this;
+    }
+
+    // Then world.resource<Events<T>>(): send() from any system, read() the events of the previous frame.
+    template <typename T> requires (std::move_constructible<T>)
+    [[nodiscard]] auto add_events() noexcept -> ZerEngine& {
+        return add_resource<Events<T>>();
+    }
+
+    [[nodiscard]] auto capture_profile(const std::size_t nb_frames, const std::string& path) noexcept -> ZerEngine& {
+        world.capture_profile(nb_frames, path);
         return *this;
     }
 
@@ -2432,6 +5491,12 @@ public:
         return *this;
     }
 
+    template <auto... Systems>
+    [[nodiscard]] auto add_systems(const Schedule<Systems...> new_schedule) noexcept -> ZerEngine& {
+        world.sys.add_schedule(new_schedule);
+        return *this;
+    }
+
     [[nodiscard]] auto add_systems(LateSystem, std::initializer_list<std::function<void(LateSystem, World&)>>&& funcs) noexcept -> ZerEngine& {
         world.sys.addLateCondSys(nullptr, std::move(funcs));
         return *this;
@@ -2486,25 +5551,90 @@ public:
         return *this;
     }
 
-    void run() noexcept {
+    // Replaces the wall clock read by Time (replays, tests, simulations faster than real time).
+    [[nodiscard]] auto set_clock(TimeSource&& newClock) noexcept -> ZerEngine& {
+        auto [time] = world.resource<Time>();
+        time.set_clock(std::move(newClock));
+        return *this;
+    }
+
+    // Runs the start systems: required once before step(), done by run() and run_frames().
+    void start() noexcept {
         world.isRunning = true;
         world.sys.start(world);
         world.upgrade();
+        world.res.swap_event_buffers();
+        if (isFlushingDiagnostics) {
+            Diagnostics::flush();
+        }
+        world.pacer.next_frame = FramePacer::Clock::now();
+        isStarted = true;
+    }
+
+    // Runs one frame of delta seconds, for engines driven by an external scheduler.
+    void step(float delta) noexcept {
+        if (!isStarted) {
+            start();
+        }
+        auto [time] = world.resource<Time>();
+        time.update(delta);
+        run_frame();
+    }
+
+    // Runs nb_frames frames of fixed_delta seconds as fast as possible (batch simulation, deterministic benchmarks).
+    void run_frames(std::size_t nb_frames, float fixed_delta) noexcept {
+        if (!isStarted) {
+            start();
+        }
+        for (std::size_t i = 0; i < nb_frames && world.isRunning; i++) {
+            step(fixed_delta);
+        }
+    }
+
+    void run() noexcept {
+        if (!isStarted) {
+            start();
+        }
         while (world.isRunning) {
+            tick();
+            if (world.isRunning) {
+                auto [time] = world.resource<const Time>();
+                world.pacer.wait_next_frame(time.seconds_until_fixed_step());
+            }
+        }
+    }
+
+private:
+    // One real-time frame, its delta is read from the clock.
+    void tick() noexcept {
+        auto [time] = world.resource<Time>();
+        time.update();
+        run_frame();
+    }
+
+    void run_frame() noexcept {
+        {
+            ZERENGINE_PROFILE_SCOPE(world.profiler, "Frame");
             auto [time] = world.resource<Time>();
-            time.update();
 
+            {
+                ZERENGINE_PROFILE_SCOPE(world.profiler, "Coroutines");
+                world.coroutines.resume_frame(time.delta());
+            }
             world.sys.run(world);
 
             if (time.is_time_step()) {
                 if (time.timeScale != 0) {
                     for (unsigned int i = 0; i < time.get_nb_fixed_steps(); i++) {
+                        ZERENGINE_PROFILE_SCOPE(world.profiler, "FixedStep");
                         world.sys.run_callbacks(world);
                         world.upgrade();
+                        world.coroutines.resume_fixed_step();
                         world.sys.runFixed(world);
                     }
                 }
                 for (unsigned int i = 0; i < time.get_nb_fixed_steps(); i++) {
+                    ZERENGINE_PROFILE_SCOPE(world.profiler, "UnscaledFixedStep");
                     world.sys.run_callbacks(world);
                     world.upgrade();
                     world.sys.runUnscaledFixed(world);
@@ -2517,11 +5647,193 @@ public:
 
             world.sys.run_callbacks(world);
             world.upgrade();
+            world.stream_scene_slice();
+            world.res.swap_event_buffers();
+            if (isFlushingDiagnostics) {
+                Diagnostics::flush();
+            }
         }
+        world.profiler.end_frame();
     }
 
 private:
     World world;
+    bool isStarted = false;
+    // False when ticked by an Executor, which flushes once per round.
+    bool isFlushingDiagnostics = true;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+// Ticks many independent ZerEngines on one shared pool of worker threads, instead of one ThreadPool per World.
+// A worker runs a whole frame of one World (its threaded systems run inline), then requeues it: the World whose next
+// frame is due the earliest goes first, and equal deadlines are served in round robin so that no World starves.
+// Frame pacing is honored through the deadlines, without blocking the workers between two frames.
+class [[nodiscard]] Executor final {
+private:
+    using Clock = FramePacer::Clock;
+
+    struct [[nodiscard]] Job final {
+        ZerEngine* engine;
+        Clock::time_point deadline;
+        std::size_t sequence;
+        std::size_t nb_frames_left;
+
+        [[nodiscard]] friend constexpr auto operator >(const Job& a, const Job& b) noexcept -> bool {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+
+public:
+    Executor(std::size_t nb_threads = std::max(std::thread::hardware_concurrency(), 1u)) noexcept {
+        for (std::size_t i = 0; i < nb_threads; i++) {
+            threads.emplace_back([this] {
+                task();
+            });
+        }
+    }
+
+    Executor(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    auto operator=(const Executor&) -> Executor& = delete;
+    auto operator=(Executor&&) -> Executor& = delete;
+
+    ~Executor() noexcept {
+        {
+            const std::unique_lock<std::mutex> lock(mtx);
+            isStop = true;
+        }
+        cvTask.notify_all();
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+
+    // The engine must outlive the Executor runs, its own multithreading is disabled.
+    auto add(ZerEngine& engine) noexcept -> Executor& {
+        (void)engine.use_multithreading(false);
+        engine.isFlushingDiagnostics = false;
+        engines.emplace_back(&engine);
+        return *this;
+    }
+
+    // Runs nb_frames frames of fixed_delta seconds on every engine, as fast as possible.
+    void run_frames(std::size_t nb_frames, float fixed_delta) noexcept {
+        if (nb_frames > 0) {
+            run_jobs(true, nb_frames, fixed_delta);
+        }
+    }
+
+    // Runs every engine in real time until all of them called world.stop_run().
+    void run() noexcept {
+        run_jobs(false, 0, 0);
+    }
+
+private:
+    void run_jobs(const bool is_batch, const std::size_t nb_frames, const float fixed_delta) noexcept {
+        std::unique_lock<std::mutex> lock(mtx);
+        isBatch = is_batch;
+        frame_delta = fixed_delta;
+        const auto now = Clock::now();
+        for (auto engine: engines) {
+            if (!engine->isStarted) {
+                engine->start();
+            }
+            engine->world.pacer.next_frame = now;
+            jobs.emplace(engine, now, next_sequence++, nb_frames);
+            nbJobs++;
+        }
+        cvTask.notify_all();
+        cvFinished.wait(lock, [this] {
+            return nbJobs == 0;
+        });
+        lock.unlock();
+        Diagnostics::flush();
+    }
+
+    void task() noexcept {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cvTask.wait(lock, [this] {
+                return isStop || !jobs.empty();
+            });
+            if (isStop) {
+                return;
+            }
+
+            // An earlier job can be pushed meanwhile: the wait is interrupted and the heap checked again.
+            if (const auto deadline = jobs.top().deadline; deadline > Clock::now()) {
+                cvTask.wait_until(lock, deadline);
+                continue;
+            }
+
+            auto job = jobs.top();
+            jobs.pop();
+            lock.unlock();
+
+            auto& world = job.engine->world;
+            bool is_done;
+            if (isBatch) {
+                job.engine->step(frame_delta);
+                job.nb_frames_left--;
+                is_done = job.nb_frames_left == 0 || !world.isRunning;
+            } else {
+                job.engine->tick();
+                is_done = !world.isRunning;
+                job.deadline = next_deadline(world);
+            }
+
+            if ((nbFrames.fetch_add(1, std::memory_order_relaxed) + 1) % engines.size() == 0) {
+                Diagnostics::flush();
+            }
+
+            lock.lock();
+            if (is_done) {
+                nbJobs--;
+                if (nbJobs == 0) {
+                    cvFinished.notify_all();
+                }
+            } else {
+                job.sequence = next_sequence++;
+                jobs.emplace(job);
+                cvTask.notify_one();
+            }
+        }
+    }
+
+    [[nodiscard]] static auto next_deadline(World& world) noexcept -> Clock::time_point {
+        auto& pacer = world.pacer;
+        switch (pacer.pacing) {
+            case FramePacing::TARGET_TICK_RATE: {
+                const auto now = Clock::now();
+                pacer.next_frame += pacer.frame_duration;
+                if (pacer.next_frame + pacer.frame_duration < now) {
+                    pacer.next_frame = now;
+                }
+                return pacer.next_frame;
+            }
+            case FramePacing::EVENT_DRIVEN: {
+                auto [time] = world.resource<const Time>();
+                return Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(std::max(time.seconds_until_fixed_step(), 0.0f)));
+            }
+            default:
+                return Clock::time_point();
+        }
+    }
+
+private:
+    std::vector<ZerEngine*> engines;
+    std::priority_queue<Job, std::vector<Job>, std::greater<Job>> jobs;
+    std::size_t next_sequence {0};
+    std::size_t nbJobs {0};
+    std::atomic<std::size_t> nbFrames {0};
+    float frame_delta {0};
+    bool isBatch {false};
+    std::mutex mtx;
+    std::condition_variable cvTask;
+    std::condition_variable cvFinished;
+    std::vector<std::thread> threads;
+    bool isStop {false};
 };
 
 ///////////////////////////////////////////////////////////////////////////////////